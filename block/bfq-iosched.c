@@ -2477,7 +2477,13 @@ static bool bfq_bio_merge(struct request_queue *q, struct bio *bio,
 	struct bfq_io_cq *bic = bfq_bic_lookup(q);
 	bool ret;
 
-	spin_lock_irq(&bfqd->lock);
+	/*
+	 * Merging is opportunistic, and a bio that is not merged here
+	 * still gets a chance at insert time. Don't pile up on
+	 * bfqd->lock behind dispatch and completion just for that.
+	 */
+	if (!spin_trylock_irq(&bfqd->lock))
+		return false;
 
 	if (bic) {
 		/*
@@ -6141,27 +6147,27 @@ static inline void bfq_update_insert_stats(struct request_queue *q,
 
 static struct bfq_queue *bfq_init_rq(struct request *rq);
 
-static void bfq_insert_request(struct blk_mq_hw_ctx *hctx, struct request *rq,
-			       bool at_head)
+/*
+ * Insert @rq with bfqd->lock held. Returns false if @rq got merged into
+ * another request and added to @free, true otherwise. In the latter case
+ * *@bfqqp, *@cmd_flags and *@idle_timer_disabled are set for
+ * bfq_update_insert_stats().
+ */
+static bool __bfq_insert_locked(struct blk_mq_hw_ctx *hctx, struct request *rq,
+				bool at_head, struct list_head *free,
+				struct bfq_queue **bfqqp, blk_opf_t *cmd_flags,
+				bool *idle_timer_disabled)
 {
 	struct request_queue *q = hctx->queue;
 	struct bfq_data *bfqd = q->elevator->elevator_data;
 	struct bfq_queue *bfqq;
-	bool idle_timer_disabled = false;
-	blk_opf_t cmd_flags;
-	LIST_HEAD(free);
 
-#ifdef CONFIG_BFQ_GROUP_IOSCHED
-	if (!cgroup_subsys_on_dfl(io_cgrp_subsys) && rq->bio)
-		bfqg_stats_update_legacy_io(q, rq);
-#endif
-	spin_lock_irq(&bfqd->lock);
+	lockdep_assert_held(&bfqd->lock);
+
+	*idle_timer_disabled = false;
 	bfqq = bfq_init_rq(rq);
-	if (blk_mq_sched_try_insert_merge(q, rq, &free)) {
-		spin_unlock_irq(&bfqd->lock);
-		blk_mq_free_requests(&free);
-		return;
-	}
+	if (blk_mq_sched_try_insert_merge(q, rq, free))
+		return false;
 
 	trace_block_rq_insert(rq);
 
@@ -6171,7 +6177,7 @@ static void bfq_insert_request(struct blk_mq_hw_ctx *hctx, struct request *rq,
 		else
 			list_add_tail(&rq->queuelist, &bfqd->dispatch);
 	} else {
-		idle_timer_disabled = __bfq_insert_request(bfqd, rq);
+		*idle_timer_disabled = __bfq_insert_request(bfqd, rq);
 		/*
 		 * Update bfqq, because, if a queue merge has occurred
 		 * in __bfq_insert_request, then rq has been
@@ -6191,9 +6197,43 @@ static void bfq_insert_request(struct blk_mq_hw_ctx *hctx, struct request *rq,
 	 * may disappear afterwards (for example, because of a request
 	 * merge).
 	 */
-	cmd_flags = rq->cmd_flags;
+	*cmd_flags = rq->cmd_flags;
+	*bfqqp = bfqq;
+	return true;
+}
+
+static void bfq_insert_legacy_io_stats(struct request_queue *q,
+				       struct request *rq)
+{
+#ifdef CONFIG_BFQ_GROUP_IOSCHED
+	if (!cgroup_subsys_on_dfl(io_cgrp_subsys) && rq->bio)
+		bfqg_stats_update_legacy_io(q, rq);
+#endif
+}
+
+static void bfq_insert_request(struct blk_mq_hw_ctx *hctx, struct request *rq,
+			       bool at_head)
+{
+	struct request_queue *q = hctx->queue;
+	struct bfq_data *bfqd = q->elevator->elevator_data;
+	struct bfq_queue *bfqq;
+	bool idle_timer_disabled;
+	blk_opf_t cmd_flags;
+	bool inserted;
+	LIST_HEAD(free);
+
+	bfq_insert_legacy_io_stats(q, rq);
+
+	spin_lock_irq(&bfqd->lock);
+	inserted = __bfq_insert_locked(hctx, rq, at_head, &free, &bfqq,
+				       &cmd_flags, &idle_timer_disabled);
 	spin_unlock_irq(&bfqd->lock);
 
+	if (!inserted) {
+		blk_mq_free_requests(&free);
+		return;
+	}
+
 	bfq_update_insert_stats(q, bfqq, idle_timer_disabled,
 				cmd_flags);
 }
@@ -6201,13 +6241,46 @@ static void bfq_insert_request(struct blk_mq_hw_ctx *hctx, struct request *rq,
 static void bfq_insert_requests(struct blk_mq_hw_ctx *hctx,
 				struct list_head *list, bool at_head)
 {
+	struct request_queue *q = hctx->queue;
+	struct bfq_data *bfqd = q->elevator->elevator_data;
+	struct request *rq;
+	LIST_HEAD(free);
+
+	/*
+	 * The per-request insert statistics have to be updated outside
+	 * of bfqd->lock, so only batch when they are not compiled in.
+	 */
+	if (IS_ENABLED(CONFIG_BFQ_CGROUP_DEBUG)) {
+		while (!list_empty(list)) {
+			rq = list_first_entry(list, struct request, queuelist);
+			list_del_init(&rq->queuelist);
+			bfq_insert_request(hctx, rq, at_head);
+		}
+		return;
+	}
+
+	list_for_each_entry(rq, list, queuelist)
+		bfq_insert_legacy_io_stats(q, rq);
+
+	/*
+	 * Insert a whole plug worth of requests with a single lock
+	 * round trip, instead of bouncing bfqd->lock with dispatch and
+	 * completion for every request.
+	 */
+	spin_lock_irq(&bfqd->lock);
 	while (!list_empty(list)) {
-		struct request *rq;
+		struct bfq_queue *bfqq;
+		bool idle_timer_disabled;
+		blk_opf_t cmd_flags;
 
 		rq = list_first_entry(list, struct request, queuelist);
 		list_del_init(&rq->queuelist);
-		bfq_insert_request(hctx, rq, at_head);
+		__bfq_insert_locked(hctx, rq, at_head, &free, &bfqq,
+				    &cmd_flags, &idle_timer_disabled);
 	}
+	spin_unlock_irq(&bfqd->lock);
+
+	blk_mq_free_requests(&free);
 }
 
 static void bfq_update_hw_tag(struct bfq_data *bfqd)
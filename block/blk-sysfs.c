@@ -517,6 +517,52 @@ static ssize_t queue_wb_lat_store(struct request_queue *q, const char *page,
 	return count;
 }
 
+static ssize_t queue_wb_adaptive_show(struct request_queue *q, char *page)
+{
+	if (!wbt_rq_qos(q))
+		return -EINVAL;
+
+	return sprintf(page, "%d\n", wbt_get_adaptive(q));
+}
+
+static ssize_t queue_wb_adaptive_store(struct request_queue *q,
+				       const char *page, size_t count)
+{
+	unsigned long val;
+	ssize_t ret;
+
+	ret = queue_var_store(&val, page, count);
+	if (ret < 0)
+		return ret;
+
+	if (!wbt_rq_qos(q)) {
+		ret = wbt_init(q);
+		if (ret)
+			return ret;
+	}
+
+	if (wbt_get_adaptive(q) == !!val)
+		return count;
+
+	/* wbt_lat_usec set to 0 by the user disables wbt, keep it that way */
+	if (val && !wbt_get_min_lat(q))
+		return -EINVAL;
+
+	/*
+	 * Same as for the latency update: the limits are recomputed and wbt
+	 * may be turned on, so make sure no IO is inflight.
+	 */
+	blk_mq_freeze_queue(q);
+	blk_mq_quiesce_queue(q);
+
+	wbt_set_adaptive(q, val);
+
+	blk_mq_unquiesce_queue(q);
+	blk_mq_unfreeze_queue(q);
+
+	return count;
+}
+
 static ssize_t queue_wc_show(struct request_queue *q, char *page)
 {
 	if (test_bit(QUEUE_FLAG_WC, &q->queue_flags))
@@ -605,6 +651,7 @@ QUEUE_RO_ENTRY(queue_fua, "fua");
 QUEUE_RO_ENTRY(queue_dax, "dax");
 QUEUE_RW_ENTRY(queue_io_timeout, "io_timeout");
 QUEUE_RW_ENTRY(queue_wb_lat, "wbt_lat_usec");
+QUEUE_RW_ENTRY(queue_wb_adaptive, "wbt_adaptive");
 QUEUE_RO_ENTRY(queue_virt_boundary_mask, "virt_boundary_mask");
 QUEUE_RO_ENTRY(queue_dma_alignment, "dma_alignment");
 
@@ -662,6 +709,7 @@ static struct attribute *queue_attrs[] = {
 	&queue_fua_entry.attr,
 	&queue_dax_entry.attr,
 	&queue_wb_lat_entry.attr,
+	&queue_wb_adaptive_entry.attr,
 	&queue_poll_delay_entry.attr,
 	&queue_io_timeout_entry.attr,
 #ifdef CONFIG_BLK_DEV_THROTTLING_LOW
@@ -15,6 +15,10 @@
  *   scaling step of 0 if reads show up or the heavy writers finish. Unlike
  *   positive scaling steps where we shrink the monitoring window, a negative
  *   scaling step retains the default step==0 window size.
+ * - In adaptive mode, the latency target and window size are derived from
+ *   the read and write latencies observed on the device, and a write that
+ *   takes far longer than usual (an erase block stall on cheap flash) is
+ *   treated like an exceeded latency target.
  *
  * Copyright (C) 2016 Jens Axboe
  *
@@ -73,6 +77,20 @@ enum {
 	 * information to scale up or down, scale up.
 	 */
 	RWB_UNKNOWN_BUMP	= 5,
+
+	/*
+	 * Adaptive mode: the latency target is a multiple of the learned
+	 * read latency floor, the window a multiple of the average write
+	 * latency, and a write this many times slower than average is a
+	 * stall.
+	 */
+	RWB_ADAPT_LAT_MULT	= 4,
+	RWB_ADAPT_WIN_MULT	= 4,
+	RWB_ADAPT_STALL_MULT	= 8,
+	RWB_ADAPT_EWMA_SHIFT	= 3,
+	RWB_ADAPT_MIN_LAT_NSEC	= 1000 * 1000ULL,
+	RWB_ADAPT_MAX_LAT_NSEC	= 250 * 1000 * 1000ULL,
+	RWB_ADAPT_MAX_WIN_NSEC	= 2000 * 1000 * 1000ULL,
 };
 
 static inline bool rwb_enabled(struct rq_wb *rwb)
@@ -350,17 +368,76 @@ static void rwb_arm_timer(struct rq_wb *rwb)
 	blk_stat_activate_nsecs(rwb->cb, rwb->cur_win_nsec);
 }
 
+/*
+ * Update the learned latencies with the stats of the window that just
+ * ended. Returns true if a write stalled for much longer than usual.
+ */
+static bool wbt_adapt(struct rq_wb *rwb, struct blk_rq_stat *stat)
+{
+	bool stall = false;
+
+	if (stat[WRITE].nr_samples) {
+		u64 avg = rwb->write_lat_avg;
+
+		if (avg && stat[WRITE].max > RWB_ADAPT_STALL_MULT * avg &&
+		    stat[WRITE].max > rwb->min_lat_nsec) {
+			rwb->nr_stalls++;
+			stall = true;
+		}
+
+		if (!avg)
+			avg = stat[WRITE].mean;
+		else
+			avg += (s64)(stat[WRITE].mean - avg) >>
+				RWB_ADAPT_EWMA_SHIFT;
+		rwb->write_lat_avg = avg;
+
+		/* Make sure a window can see writes complete */
+		rwb->win_nsec = clamp_t(u64, RWB_ADAPT_WIN_MULT * avg,
+					RWB_WINDOW_NSEC,
+					RWB_ADAPT_MAX_WIN_NSEC);
+	}
+
+	if (stat[READ].nr_samples) {
+		u64 base = rwb->read_lat_base;
+
+		/*
+		 * Follow a lower floor immediately, and let it drift up
+		 * slowly so that the target tracks an aging device without
+		 * being dragged up by a congested window.
+		 */
+		if (!base || stat[READ].min < base)
+			base = stat[READ].min;
+		else
+			base += (stat[READ].min - base) >>
+				(2 * RWB_ADAPT_EWMA_SHIFT);
+		rwb->read_lat_base = base;
+
+		rwb->min_lat_nsec = clamp_t(u64, RWB_ADAPT_LAT_MULT * base,
+					    RWB_ADAPT_MIN_LAT_NSEC,
+					    RWB_ADAPT_MAX_LAT_NSEC);
+	}
+
+	return stall;
+}
+
 static void wb_timer_fn(struct blk_stat_callback *cb)
 {
 	struct rq_wb *rwb = cb->data;
 	struct rq_depth *rqd = &rwb->rq_depth;
 	unsigned int inflight = wbt_inflight(rwb);
+	bool stall = false;
 	int status;
 
 	if (!rwb->rqos.q->disk)
 		return;
 
+	if (rwb->adaptive)
+		stall = wbt_adapt(rwb, cb->stat);
+
 	status = latency_exceeded(rwb, cb->stat);
+	if (stall)
+		status = LAT_EXCEEDED;
 
 	trace_wbt_timer(rwb->rqos.q->disk->bdi, status, rqd->scale_step,
 			inflight);
@@ -437,9 +514,43 @@ void wbt_set_min_lat(struct request_queue *q, u64 val)
 		return;
 	RQWB(rqos)->min_lat_nsec = val;
 	RQWB(rqos)->enable_state = WBT_STATE_ON_MANUAL;
+	RQWB(rqos)->adaptive = false;
 	wbt_update_limits(RQWB(rqos));
 }
 
+bool wbt_get_adaptive(struct request_queue *q)
+{
+	struct rq_qos *rqos = wbt_rq_qos(q);
+
+	return rqos && RQWB(rqos)->adaptive;
+}
+
+void wbt_set_adaptive(struct request_queue *q, bool adaptive)
+{
+	struct rq_qos *rqos = wbt_rq_qos(q);
+	struct rq_wb *rwb;
+
+	if (!rqos)
+		return;
+	rwb = RQWB(rqos);
+	if (rwb->adaptive == adaptive)
+		return;
+
+	/*
+	 * Relearn from scratch, starting from the current target, or go back
+	 * to the target that was in use before adaptive mode was turned on.
+	 */
+	rwb->read_lat_base = 0;
+	rwb->write_lat_avg = 0;
+	rwb->win_nsec = RWB_WINDOW_NSEC;
+	if (adaptive)
+		rwb->manual_lat_nsec = rwb->min_lat_nsec;
+	else
+		rwb->min_lat_nsec = rwb->manual_lat_nsec;
+	rwb->enable_state = WBT_STATE_ON_MANUAL;
+	rwb->adaptive = adaptive;
+	wbt_update_limits(rwb);
+}
 
 static bool close_io(struct rq_wb *rwb)
 {
@@ -789,6 +900,19 @@ static int wbt_background_show(void *data, struct seq_file *m)
 	return 0;
 }
 
+static int wbt_adaptive_show(void *data, struct seq_file *m)
+{
+	struct rq_qos *rqos = data;
+	struct rq_wb *rwb = RQWB(rqos);
+
+	seq_printf(m, "enabled %d\n", rwb->adaptive);
+	seq_printf(m, "read_lat_base %llu\n", rwb->read_lat_base);
+	seq_printf(m, "write_lat_avg %llu\n", rwb->write_lat_avg);
+	seq_printf(m, "win_nsec %llu\n", rwb->win_nsec);
+	seq_printf(m, "stalls %u\n", rwb->nr_stalls);
+	return 0;
+}
+
 static const struct blk_mq_debugfs_attr wbt_debugfs_attrs[] = {
 	{"curr_win_nsec", 0400, wbt_curr_win_nsec_show},
 	{"enabled", 0400, wbt_enabled_show},
@@ -798,6 +922,7 @@ static const struct blk_mq_debugfs_attr wbt_debugfs_attrs[] = {
 	{"unknown_cnt", 0400, wbt_unknown_cnt_show},
 	{"wb_normal", 0400, wbt_normal_show},
 	{"wb_background", 0400, wbt_background_show},
+	{"adaptive", 0400, wbt_adaptive_show},
 	{},
 };
 #endif
@@ -65,6 +65,17 @@ struct rq_wb {
 	unsigned long last_issue;		/* last non-throttled issue */
 	unsigned long last_comp;		/* last non-throttled comp */
 	unsigned long min_lat_nsec;
+
+	/*
+	 * Adaptive mode: learn the target latency and window size from the
+	 * device instead of using the fixed SSD/HDD defaults.
+	 */
+	bool adaptive;
+	unsigned long manual_lat_nsec;		/* target to restore when off */
+	u64 read_lat_base;			/* learned unloaded read latency */
+	u64 write_lat_avg;			/* EWMA of mean write latency */
+	unsigned int nr_stalls;			/* write stalls seen */
+
 	struct rq_qos rqos;
 	struct rq_wait rq_wait[WBT_NUM_RWQ];
 	struct rq_depth rq_depth;
@@ -94,6 +105,8 @@ void wbt_enable_default(struct request_queue *);
 
 u64 wbt_get_min_lat(struct request_queue *q);
 void wbt_set_min_lat(struct request_queue *q, u64 val);
+bool wbt_get_adaptive(struct request_queue *q);
+void wbt_set_adaptive(struct request_queue *q, bool adaptive);
 
 void wbt_set_write_cache(struct request_queue *, bool);
 
@@ -121,6 +134,13 @@ static inline u64 wbt_get_min_lat(struct request_queue *q)
 static inline void wbt_set_min_lat(struct request_queue *q, u64 val)
 {
 }
+static inline bool wbt_get_adaptive(struct request_queue *q)
+{
+	return false;
+}
+static inline void wbt_set_adaptive(struct request_queue *q, bool adaptive)
+{
+}
 static inline u64 wbt_default_latency_nsec(struct request_queue *q)
 {
 	return 0;
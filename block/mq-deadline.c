@@ -39,6 +39,13 @@ static const int prio_aging_expire = 10 * HZ;
 static const int writes_starved = 2;    /* max times reads can starve a write */
 static const int fifo_batch = 16;       /* # of sequential requests treated as one
 				     by the above parameters. For throughput. */
+/*
+ * Number of BE and IDLE requests that may be dispatched per
+ * prio_budget_window while RT requests are active. The window is 0 by
+ * default, which disables the budgets.
+ */
+static const int be_budget = 8;
+static const int idle_budget = 1;
 
 enum dd_data_dir {
 	DD_READ		= READ,
@@ -56,6 +63,13 @@ enum dd_prio {
 
 enum { DD_PRIO_COUNT = 3 };
 
+/*
+ * Completion latency histogram buckets. Bucket i counts requests that
+ * completed less than 2^i us after they were allocated, the last bucket
+ * counts everything slower.
+ */
+enum { DD_LAT_BUCKETS = 22 };
+
 /*
  * I/O statistics per I/O priority. It is fine if these counters overflow.
  * What matters is that these counters are at least as wide as
@@ -66,6 +80,7 @@ struct io_stats_per_prio {
 	uint32_t merged;
 	uint32_t dispatched;
 	atomic_t completed;
+	atomic_t lat_hist[DD_LAT_BUCKETS];
 };
 
 /*
@@ -102,6 +117,13 @@ struct deadline_data {
 	int front_merges;
 	u32 async_depth;
 	int prio_aging_expire;
+	int prio_budget_window;
+	int prio_budget[DD_PRIO_COUNT];
+
+	/* Dispatch budget accounting, see dd_prio_throttled(). */
+	unsigned long rt_active_until;
+	unsigned long budget_window_start;
+	u32 budget_used[DD_PRIO_COUNT];
 
 	spinlock_t lock;
 	spinlock_t zone_lock;
@@ -525,6 +547,9 @@ done:
 	ioprio_class = dd_rq_ioclass(rq);
 	prio = ioprio_class_to_prio[ioprio_class];
 	dd->per_prio[prio].stats.dispatched++;
+	dd->budget_used[prio]++;
+	if (prio == DD_RT_PRIO)
+		dd->rt_active_until = jiffies + dd->prio_budget_window;
 	/*
 	 * If the request needs its target zone locked, do it.
 	 */
@@ -561,6 +586,39 @@ static struct request *dd_dispatch_prio_aged_requests(struct deadline_data *dd,
 	return NULL;
 }
 
+/*
+ * Returns true if requests of priority @prio may not be dispatched right now
+ * because that priority used up its budget for the current window while RT
+ * requests are active. In that case *@wait is set to the number of jiffies
+ * after which dispatching should be retried.
+ */
+static bool dd_prio_throttled(struct deadline_data *dd, enum dd_prio prio,
+			      unsigned long now, unsigned long *wait)
+{
+	unsigned long window_end;
+
+	lockdep_assert_held(&dd->lock);
+
+	if (prio == DD_RT_PRIO || !dd->prio_budget_window ||
+	    time_after_eq(now, dd->rt_active_until))
+		return false;
+
+	window_end = dd->budget_window_start + dd->prio_budget_window;
+	if (time_after_eq(now, window_end)) {
+		dd->budget_window_start = now;
+		memset(dd->budget_used, 0, sizeof(dd->budget_used));
+		return false;
+	}
+
+	if (dd->budget_used[prio] < dd->prio_budget[prio])
+		return false;
+
+	if (time_before(dd->rt_active_until, window_end))
+		window_end = dd->rt_active_until;
+	*wait = window_end - now;
+	return true;
+}
+
 /*
  * Called from blk_mq_run_hw_queue() -> __blk_mq_sched_dispatch_requests().
  *
@@ -573,6 +631,7 @@ static struct request *dd_dispatch_request(struct blk_mq_hw_ctx *hctx)
 {
 	struct deadline_data *dd = hctx->queue->elevator->elevator_data;
 	const unsigned long now = jiffies;
+	unsigned long wait = 0;
 	struct request *rq;
 	enum dd_prio prio;
 
@@ -583,9 +642,14 @@ static struct request *dd_dispatch_request(struct blk_mq_hw_ctx *hctx)
 
 	/*
 	 * Next, dispatch requests in priority order. Ignore lower priority
-	 * requests if any higher priority requests are pending.
+	 * requests if any higher priority requests are pending. While RT
+	 * requests are active, lower priorities are further limited to their
+	 * dispatch budget so that they cannot fill up the device queue.
 	 */
 	for (prio = 0; prio <= DD_PRIO_MAX; prio++) {
+		if (dd_queued(dd, prio) &&
+		    dd_prio_throttled(dd, prio, now, &wait))
+			break;
 		rq = __dd_dispatch_request(dd, &dd->per_prio[prio], now);
 		if (rq || dd_queued(dd, prio))
 			break;
@@ -594,6 +658,11 @@ static struct request *dd_dispatch_request(struct blk_mq_hw_ctx *hctx)
 unlock:
 	spin_unlock(&dd->lock);
 
+	/* Nothing will rerun the queue once the budget is refilled. */
+	if (!rq && wait)
+		blk_mq_delay_run_hw_queues(hctx->queue,
+					   max(jiffies_to_msecs(wait), 1U));
+
 	return rq;
 }
 
@@ -698,6 +767,9 @@ static int dd_init_sched(struct request_queue *q, struct elevator_type *e)
 	dd->last_dir = DD_WRITE;
 	dd->fifo_batch = fifo_batch;
 	dd->prio_aging_expire = prio_aging_expire;
+	dd->prio_budget[DD_RT_PRIO] = INT_MAX;
+	dd->prio_budget[DD_BE_PRIO] = be_budget;
+	dd->prio_budget[DD_IDLE_PRIO] = idle_budget;
 	spin_lock_init(&dd->lock);
 	spin_lock_init(&dd->zone_lock);
 
@@ -795,6 +867,9 @@ static void dd_insert_request(struct blk_mq_hw_ctx *hctx, struct request *rq,
 		rq->elv.priv[0] = (void *)(uintptr_t)1;
 	}
 
+	if (prio == DD_RT_PRIO)
+		dd->rt_active_until = jiffies + dd->prio_budget_window;
+
 	if (blk_mq_sched_try_insert_merge(q, rq, &free)) {
 		blk_mq_free_requests(&free);
 		return;
@@ -894,6 +969,15 @@ static void dd_finish_request(struct request *rq)
 
 	atomic_inc(&per_prio->stats.completed);
 
+	/* Requests merged into another one were never started. */
+	if ((rq->rq_flags & RQF_STARTED) && rq->start_time_ns) {
+		u64 lat_us = div_u64(ktime_get_ns() - rq->start_time_ns,
+				     NSEC_PER_USEC);
+
+		atomic_inc(&per_prio->stats.lat_hist[min_t(int, fls64(lat_us),
+							   DD_LAT_BUCKETS - 1)]);
+	}
+
 	if (blk_queue_is_zoned(q)) {
 		unsigned long flags;
 
@@ -943,6 +1027,9 @@ SHOW_INT(deadline_writes_starved_show, dd->writes_starved);
 SHOW_INT(deadline_front_merges_show, dd->front_merges);
 SHOW_INT(deadline_async_depth_show, dd->async_depth);
 SHOW_INT(deadline_fifo_batch_show, dd->fifo_batch);
+SHOW_JIFFIES(deadline_prio_budget_window_show, dd->prio_budget_window);
+SHOW_INT(deadline_be_budget_show, dd->prio_budget[DD_BE_PRIO]);
+SHOW_INT(deadline_idle_budget_show, dd->prio_budget[DD_IDLE_PRIO]);
 #undef SHOW_INT
 #undef SHOW_JIFFIES
 
@@ -973,6 +1060,9 @@ STORE_INT(deadline_writes_starved_store, &dd->writes_starved, INT_MIN, INT_MAX);
 STORE_INT(deadline_front_merges_store, &dd->front_merges, 0, 1);
 STORE_INT(deadline_async_depth_store, &dd->async_depth, 1, INT_MAX);
 STORE_INT(deadline_fifo_batch_store, &dd->fifo_batch, 0, INT_MAX);
+STORE_JIFFIES(deadline_prio_budget_window_store, &dd->prio_budget_window, 0, INT_MAX);
+STORE_INT(deadline_be_budget_store, &dd->prio_budget[DD_BE_PRIO], 1, INT_MAX);
+STORE_INT(deadline_idle_budget_store, &dd->prio_budget[DD_IDLE_PRIO], 1, INT_MAX);
 #undef STORE_FUNCTION
 #undef STORE_INT
 #undef STORE_JIFFIES
@@ -988,6 +1078,9 @@ static struct elv_fs_entry deadline_attrs[] = {
 	DD_ATTR(async_depth),
 	DD_ATTR(fifo_batch),
 	DD_ATTR(prio_aging_expire),
+	DD_ATTR(prio_budget_window),
+	DD_ATTR(be_budget),
+	DD_ATTR(idle_budget),
 	__ATTR_NULL
 };
 
@@ -1096,6 +1189,29 @@ static int dd_queued_show(void *data, struct seq_file *m)
 	return 0;
 }
 
+static int dd_latency_show(void *data, struct seq_file *m)
+{
+	static const char * const names[DD_PRIO_COUNT] = {
+		[DD_RT_PRIO]	= "rt",
+		[DD_BE_PRIO]	= "be",
+		[DD_IDLE_PRIO]	= "idle",
+	};
+	struct request_queue *q = data;
+	struct deadline_data *dd = q->elevator->elevator_data;
+	enum dd_prio prio;
+	int i;
+
+	for (prio = 0; prio <= DD_PRIO_MAX; prio++) {
+		const struct io_stats_per_prio *stats = &dd->per_prio[prio].stats;
+
+		seq_printf(m, "%s:", names[prio]);
+		for (i = 0; i < DD_LAT_BUCKETS; i++)
+			seq_printf(m, " %d", atomic_read(&stats->lat_hist[i]));
+		seq_putc(m, '\n');
+	}
+	return 0;
+}
+
 /* Number of requests owned by the block driver for a given priority. */
 static u32 dd_owned_by_driver(struct deadline_data *dd, enum dd_prio prio)
 {
@@ -1194,6 +1310,7 @@ static const struct blk_mq_debugfs_attr deadline_queue_debugfs_attrs[] = {
 	{"dispatch2", 0400, .seq_ops = &deadline_dispatch2_seq_ops},
 	{"owned_by_driver", 0400, dd_owned_by_driver_show},
 	{"queued", 0400, dd_queued_show},
+	{"latency", 0400, dd_latency_show},
 	{},
 };
 #undef DEADLINE_QUEUE_DDIR_ATTRS
@@ -18,9 +18,12 @@
 #include <linux/slab.h>
 
 #include <drm/drm.h>
+#include <drm/drm_buddy.h>
 #include <drm/drm_device.h>
 #include <drm/drm_drv.h>
 #include <drm/drm_gem_dma_helper.h>
+#include <drm/drm_managed.h>
+#include <drm/drm_print.h>
 #include <drm/drm_vma_manager.h>
 
 /**
@@ -45,6 +48,211 @@
  * drm_gem_dma_vmap()). These helpers perform the necessary type conversion.
  */
 
+/**
+ * DOC: dma reserved pool
+ *
+ * On long-running systems CMA tends to fragment, and large contiguous
+ * allocations start to fail or stall on compaction. Drivers for devices that
+ * are not behind an IOMMU can call drmm_gem_dma_pool_init() at probe time,
+ * while memory is still unfragmented, to carve out a single contiguous region
+ * that is then handed out to write-combined GEM DMA objects by a buddy
+ * allocator. Freed buffers are merged back with their buddies immediately, so
+ * the pool does not need any deferred compaction.
+ *
+ * Allocations that do not fit in the pool fall back to the regular DMA API.
+ * Allocation counts, latencies and the current fragmentation of the pool can
+ * be printed with drm_gem_dma_pool_print_info().
+ */
+
+struct drm_gem_dma_pool {
+	struct drm_device *drm;
+
+	/* Protects the buddy allocator and the statistics. */
+	struct mutex lock;
+	struct drm_buddy mm;
+
+	void *vaddr;
+	dma_addr_t dma_addr;
+	size_t size;
+
+	u64 allocs;
+	u64 fallbacks;
+	u64 alloc_ns_total;
+	u64 alloc_ns_max;
+};
+
+static void drm_gem_dma_pool_release(struct drm_device *drm, void *ptr)
+{
+	struct drm_gem_dma_pool *pool = ptr;
+
+	drm_buddy_fini(&pool->mm);
+	dma_free_wc(drm->dev, pool->size, pool->vaddr, pool->dma_addr);
+	drm->dma_pool = NULL;
+}
+
+/**
+ * drmm_gem_dma_pool_init - carve out a reserved pool for DMA GEM objects
+ * @drm: DRM device
+ * @size: size of the pool in bytes
+ *
+ * This function allocates a physically contiguous region of @size bytes and
+ * sets it up as the backing store of all subsequent write-combined
+ * drm_gem_dma_create() allocations on @drm. The pool is released
+ * automatically when @drm is.
+ *
+ * Returns:
+ * 0 on success or a negative error code on failure.
+ */
+int drmm_gem_dma_pool_init(struct drm_device *drm, size_t size)
+{
+	struct drm_gem_dma_pool *pool;
+	int ret;
+
+	if (drm_WARN_ON(drm, drm->dma_pool))
+		return -EBUSY;
+
+	/* Sub-allocations can't be mapped through an IOMMU domain. */
+	if (device_iommu_mapped(drm->dev))
+		return -EINVAL;
+
+	size = round_down(size, PAGE_SIZE);
+	if (!size)
+		return -EINVAL;
+
+	pool = drmm_kzalloc(drm, sizeof(*pool), GFP_KERNEL);
+	if (!pool)
+		return -ENOMEM;
+
+	pool->drm = drm;
+	pool->size = size;
+
+	ret = drmm_mutex_init(drm, &pool->lock);
+	if (ret)
+		return ret;
+
+	pool->vaddr = dma_alloc_wc(drm->dev, size, &pool->dma_addr,
+				   GFP_KERNEL | __GFP_NOWARN);
+	if (!pool->vaddr)
+		return -ENOMEM;
+
+	ret = drm_buddy_init(&pool->mm, size, PAGE_SIZE);
+	if (ret) {
+		dma_free_wc(drm->dev, size, pool->vaddr, pool->dma_addr);
+		return ret;
+	}
+
+	drm->dma_pool = pool;
+
+	return drmm_add_action_or_reset(drm, drm_gem_dma_pool_release, pool);
+}
+EXPORT_SYMBOL_GPL(drmm_gem_dma_pool_init);
+
+static int drm_gem_dma_pool_alloc(struct drm_gem_dma_pool *pool,
+				  struct drm_gem_dma_object *dma_obj,
+				  size_t size)
+{
+	u64 block_size = roundup_pow_of_two(size);
+	struct drm_buddy_block *block;
+	ktime_t start = ktime_get();
+	u64 delta;
+	int ret;
+
+	INIT_LIST_HEAD(&dma_obj->pool_blocks);
+
+	mutex_lock(&pool->lock);
+
+	/*
+	 * A single block of the next power of two keeps the allocation
+	 * contiguous, the tail is then given back to the allocator.
+	 */
+	ret = drm_buddy_alloc_blocks(&pool->mm, 0, pool->size,
+				     block_size, block_size,
+				     &dma_obj->pool_blocks, 0);
+	if (ret) {
+		pool->fallbacks++;
+		goto out_unlock;
+	}
+
+	ret = drm_buddy_block_trim(&pool->mm, size, &dma_obj->pool_blocks);
+	if (ret) {
+		drm_buddy_free_list(&pool->mm, &dma_obj->pool_blocks);
+		pool->fallbacks++;
+		goto out_unlock;
+	}
+
+	block = list_first_entry(&dma_obj->pool_blocks,
+				 struct drm_buddy_block, link);
+	dma_obj->vaddr = pool->vaddr + drm_buddy_block_offset(block);
+	dma_obj->dma_addr = pool->dma_addr + drm_buddy_block_offset(block);
+	dma_obj->pooled = true;
+
+	delta = ktime_to_ns(ktime_sub(ktime_get(), start));
+	pool->allocs++;
+	pool->alloc_ns_total += delta;
+	pool->alloc_ns_max = max(pool->alloc_ns_max, delta);
+
+out_unlock:
+	mutex_unlock(&pool->lock);
+
+	return ret;
+}
+
+static void drm_gem_dma_pool_free(struct drm_gem_dma_pool *pool,
+				  struct drm_gem_dma_object *dma_obj)
+{
+	mutex_lock(&pool->lock);
+	drm_buddy_free_list(&pool->mm, &dma_obj->pool_blocks);
+	mutex_unlock(&pool->lock);
+}
+
+/**
+ * drm_gem_dma_pool_print_info - print reserved pool statistics
+ * @drm: DRM device
+ * @p: DRM printer
+ *
+ * This function prints the allocation statistics and the per-order free
+ * lists of the pool set up with drmm_gem_dma_pool_init(), for use in e.g.
+ * debugfs output. The fragmentation is reported as the share of free memory
+ * that is not part of the largest free block.
+ */
+void drm_gem_dma_pool_print_info(struct drm_device *drm, struct drm_printer *p)
+{
+	struct drm_gem_dma_pool *pool = drm->dma_pool;
+	u64 largest = 0;
+	int order;
+
+	if (!pool) {
+		drm_printf(p, "no reserved pool\n");
+		return;
+	}
+
+	mutex_lock(&pool->lock);
+
+	for (order = pool->mm.max_order; order >= 0; order--) {
+		if (!list_empty(&pool->mm.free_list[order])) {
+			largest = pool->mm.chunk_size << order;
+			break;
+		}
+	}
+
+	drm_printf(p, "base: %pad, size: %zuKiB\n", &pool->dma_addr,
+		   pool->size >> 10);
+	drm_printf(p, "allocs: %llu, fallbacks: %llu\n",
+		   pool->allocs, pool->fallbacks);
+	if (pool->allocs)
+		drm_printf(p, "alloc latency avg: %lluns, max: %lluns\n",
+			   div64_u64(pool->alloc_ns_total, pool->allocs),
+			   pool->alloc_ns_max);
+	drm_printf(p, "largest free: %lluKiB, fragmentation: %llu%%\n",
+		   largest >> 10,
+		   pool->mm.avail ?
+		   div64_u64((pool->mm.avail - largest) * 100, pool->mm.avail) : 0);
+	drm_buddy_print(&pool->mm, p);
+
+	mutex_unlock(&pool->lock);
+}
+EXPORT_SYMBOL_GPL(drm_gem_dma_pool_print_info);
+
 static const struct drm_gem_object_funcs drm_gem_dma_default_funcs = {
 	.free = drm_gem_dma_object_free,
 	.print_info = drm_gem_dma_object_print_info,
@@ -143,6 +351,10 @@ struct drm_gem_dma_object *drm_gem_dma_create(struct drm_device *drm,
 	if (IS_ERR(dma_obj))
 		return dma_obj;
 
+	if (drm->dma_pool && !dma_obj->map_noncoherent &&
+	    !drm_gem_dma_pool_alloc(drm->dma_pool, dma_obj, size))
+		return dma_obj;
+
 	if (dma_obj->map_noncoherent) {
 		dma_obj->vaddr = dma_alloc_noncoherent(drm->dev, size,
 						       &dma_obj->dma_addr,
@@ -215,6 +427,37 @@ drm_gem_dma_create_with_handle(struct drm_file *file_priv,
 	return dma_obj;
 }
 
+/**
+ * drm_gem_dma_free_buffer - free the backing memory of a DMA GEM object
+ * @dma_obj: DMA GEM object whose backing memory to free
+ *
+ * Returns the backing memory of a non-imported object to the reserved pool
+ * or the DMA API, whichever it came from, and clears the virtual address.
+ * Drivers purging the storage of objects they keep around must use this
+ * rather than freeing it with the DMA API themselves.
+ */
+void drm_gem_dma_free_buffer(struct drm_gem_dma_object *dma_obj)
+{
+	struct drm_gem_object *gem_obj = &dma_obj->base;
+
+	if (!dma_obj->vaddr)
+		return;
+
+	if (dma_obj->pooled)
+		drm_gem_dma_pool_free(gem_obj->dev->dma_pool, dma_obj);
+	else if (dma_obj->map_noncoherent)
+		dma_free_noncoherent(gem_obj->dev->dev, dma_obj->base.size,
+				     dma_obj->vaddr, dma_obj->dma_addr,
+				     DMA_TO_DEVICE);
+	else
+		dma_free_wc(gem_obj->dev->dev, dma_obj->base.size,
+			    dma_obj->vaddr, dma_obj->dma_addr);
+
+	dma_obj->vaddr = NULL;
+	dma_obj->pooled = false;
+}
+EXPORT_SYMBOL_GPL(drm_gem_dma_free_buffer);
+
 /**
  * drm_gem_dma_free - free resources associated with a DMA GEM object
  * @dma_obj: DMA GEM object to free
@@ -232,14 +475,8 @@ void drm_gem_dma_free(struct drm_gem_dma_object *dma_obj)
 		if (dma_obj->vaddr)
 			dma_buf_vunmap(gem_obj->import_attach->dmabuf, &map);
 		drm_prime_gem_destroy(gem_obj, dma_obj->sgt);
-	} else if (dma_obj->vaddr) {
-		if (dma_obj->map_noncoherent)
-			dma_free_noncoherent(gem_obj->dev->dev, dma_obj->base.size,
-					     dma_obj->vaddr, dma_obj->dma_addr,
-					     DMA_TO_DEVICE);
-		else
-			dma_free_wc(gem_obj->dev->dev, dma_obj->base.size,
-				    dma_obj->vaddr, dma_obj->dma_addr);
+	} else {
+		drm_gem_dma_free_buffer(dma_obj);
 	}
 
 	drm_gem_object_release(gem_obj);
@@ -304,8 +304,7 @@ static void vc4_bo_purge(struct drm_gem_object *obj)
 
 	drm_vma_node_unmap(&obj->vma_node, dev->anon_inode->i_mapping);
 
-	dma_free_wc(dev->dev, obj->size, bo->base.vaddr, bo->base.dma_addr);
-	bo->base.vaddr = NULL;
+	drm_gem_dma_free_buffer(&bo->base);
 	bo->madv = __VC4_MADV_PURGED;
 }
 
@@ -14,6 +14,16 @@
 #include "vc4_drv.h"
 #include "vc4_regs.h"
 
+static int vc4_dma_pool_debugfs(struct seq_file *m, void *unused)
+{
+	struct drm_info_node *node = (struct drm_info_node *)m->private;
+	struct drm_printer p = drm_seq_file_printer(m);
+
+	drm_gem_dma_pool_print_info(node->minor->dev, &p);
+
+	return 0;
+}
+
 /*
  * Called at drm_dev_register() time on each of the minors registered
  * by the DRM device, to attach the debugfs files.
@@ -27,6 +37,10 @@ vc4_debugfs_init(struct drm_minor *minor)
 	if (vc4->hvs)
 		drm_WARN_ON(drm, vc4_hvs_debugfs_init(minor));
 
+	if (drm->dma_pool)
+		drm_WARN_ON(drm, vc4_debugfs_add_file(minor, "dma_pool",
+						      vc4_dma_pool_debugfs, NULL));
+
 	if (vc4->v3d) {
 		drm_WARN_ON(drm, vc4_bo_debugfs_init(minor));
 		drm_WARN_ON(drm, vc4_v3d_debugfs_init(minor));
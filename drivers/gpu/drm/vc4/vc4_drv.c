@@ -51,6 +51,11 @@
 #define DRIVER_MINOR 0
 #define DRIVER_PATCHLEVEL 0
 
+static unsigned int vc4_dma_pool_mb;
+module_param_named(dma_pool_mb, vc4_dma_pool_mb, uint, 0444);
+MODULE_PARM_DESC(dma_pool_mb,
+		 "Size in MiB of the reserved pool for buffer allocations, carved out at bind time (0 = disabled)");
+
 /* Helper function for mapping the regs on a platform device. */
 void __iomem *vc4_ioremap_regs(struct platform_device *pdev, int index)
 {
@@ -368,6 +373,13 @@ static int vc4_drm_bind(struct device *dev)
 	platform_set_drvdata(pdev, drm);
 	INIT_LIST_HEAD(&vc4->debugfs_list);
 
+	if (vc4_dma_pool_mb) {
+		ret = drmm_gem_dma_pool_init(drm, (size_t)vc4_dma_pool_mb * SZ_1M);
+		if (ret)
+			drm_warn(drm, "Couldn't set up %u MiB reserved pool: %d\n",
+				 vc4_dma_pool_mb, ret);
+	}
+
 	if (gen == VC4_GEN_4) {
 		ret = drmm_mutex_init(drm, &vc4->bin_bo_lock);
 		if (ret)
@@ -87,6 +87,8 @@ enum vc4_gen {
 	VC4_GEN_6,
 };
 
+#define VC4_JOB_LATENCY_BUCKETS	20
+
 struct vc4_dev {
 	struct drm_device base;
 	struct device *dev;
@@ -156,9 +158,11 @@ struct vc4_dev {
 	uint64_t emit_seqno;
 
 	/* Sequence number for the last completed job on the GPU.
-	 * Starts at 0 (no jobs completed).
+	 * Starts at 0 (no jobs completed).  Only incremented from the
+	 * IRQ handler under job_lock, but read locklessly by seqno
+	 * and fence waiters.
 	 */
-	uint64_t finished_seqno;
+	atomic64_t finished_seqno;
 
 	/* List of all struct vc4_exec_info for jobs to be executed in
 	 * the binner.  The first job in the list is the one currently
@@ -194,6 +198,12 @@ struct vc4_dev {
 	 */
 	struct list_head seqno_cb_list;
 
+	/* Histogram of the time between a job's submission and the
+	 * signalling of its fence, in power-of-two microsecond buckets.
+	 * Protected by job_lock.
+	 */
+	u32 job_latency_hist[VC4_JOB_LATENCY_BUCKETS];
+
 	/* The memory used for storing binner tile alloc, tile state,
 	 * and overflow memory allocations.  This is freed when V3D
 	 * powers down.
@@ -563,6 +573,7 @@ struct vc4_crtc_data {
 
 struct vc4_txp_data {
 	struct vc4_crtc_data	base;
+	const char *jobs_debugfs_name;
 	enum vc4_encoder_type encoder_type;
 	unsigned int high_addr_ptr_reg;
 	unsigned int has_byte_enable:1;
@@ -754,6 +765,9 @@ struct vc4_exec_info {
 	/* Sequence number for this bin/render job. */
 	uint64_t seqno;
 
+	/* Time at which the job was queued for the binner. */
+	ktime_t submit_time;
+
 	/* Latest write_seqno of any BO that binning depends on. */
 	uint64_t bin_dep_seqno;
 
@@ -1100,6 +1114,7 @@ void vc4_move_job_to_render(struct drm_device *dev, struct vc4_exec_info *exec);
 int vc4_wait_for_seqno(struct drm_device *dev, uint64_t seqno,
 		       uint64_t timeout_ns, bool interruptible);
 void vc4_job_handle_completed(struct vc4_dev *vc4);
+void vc4_flush_seqno_cbs(struct vc4_dev *vc4);
 int vc4_queue_seqno_cb(struct drm_device *dev,
 		       struct vc4_seqno_cb *cb, uint64_t seqno,
 		       void (*func)(struct vc4_seqno_cb *cb));
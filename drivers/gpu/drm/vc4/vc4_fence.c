@@ -38,7 +38,7 @@ static bool vc4_fence_signaled(struct dma_fence *fence)
 	struct vc4_fence *f = to_vc4_fence(fence);
 	struct vc4_dev *vc4 = to_vc4_dev(f->dev);
 
-	return vc4->finished_seqno >= f->seqno;
+	return atomic64_read(&vc4->finished_seqno) >= f->seqno;
 }
 
 const struct dma_fence_ops vc4_fence_ops = {
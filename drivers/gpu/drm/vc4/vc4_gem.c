@@ -392,7 +392,7 @@ vc4_wait_for_seqno(struct drm_device *dev, uint64_t seqno, uint64_t timeout_ns,
 	if (WARN_ON_ONCE(vc4->gen > VC4_GEN_4))
 		return -ENODEV;
 
-	if (vc4->finished_seqno >= seqno)
+	if (atomic64_read(&vc4->finished_seqno) >= seqno)
 		return 0;
 
 	if (timeout_ns == 0)
@@ -411,7 +411,7 @@ vc4_wait_for_seqno(struct drm_device *dev, uint64_t seqno, uint64_t timeout_ns,
 			break;
 		}
 
-		if (vc4->finished_seqno >= seqno)
+		if (atomic64_read(&vc4->finished_seqno) >= seqno)
 			break;
 
 		if (timeout_ns != ~0ull) {
@@ -700,6 +700,7 @@ vc4_queue_submit(struct drm_device *dev, struct vc4_exec_info *exec,
 
 	seqno = ++vc4->emit_seqno;
 	exec->seqno = seqno;
+	exec->submit_time = ktime_get();
 
 	dma_fence_init(&fence->base, &vc4_fence_ops, &vc4->job_lock,
 		       vc4->dma_fence_context, exec->seqno);
@@ -1010,7 +1011,6 @@ void
 vc4_job_handle_completed(struct vc4_dev *vc4)
 {
 	unsigned long irqflags;
-	struct vc4_seqno_cb *cb, *cb_temp;
 
 	if (WARN_ON_ONCE(vc4->gen > VC4_GEN_4))
 		return;
@@ -1027,14 +1027,29 @@ vc4_job_handle_completed(struct vc4_dev *vc4)
 		spin_lock_irqsave(&vc4->job_lock, irqflags);
 	}
 
+	vc4_flush_seqno_cbs(vc4);
+
+	spin_unlock_irqrestore(&vc4->job_lock, irqflags);
+}
+
+/* Schedules the callbacks of all seqnos that have passed.  Called
+ * with job_lock held, directly from the render done interrupt so that
+ * the callbacks don't have to wait for job_done_work first.
+ */
+void
+vc4_flush_seqno_cbs(struct vc4_dev *vc4)
+{
+	u64 finished_seqno = atomic64_read(&vc4->finished_seqno);
+	struct vc4_seqno_cb *cb, *cb_temp;
+
+	lockdep_assert_held(&vc4->job_lock);
+
 	list_for_each_entry_safe(cb, cb_temp, &vc4->seqno_cb_list, work.entry) {
-		if (cb->seqno <= vc4->finished_seqno) {
+		if (cb->seqno <= finished_seqno) {
 			list_del_init(&cb->work.entry);
 			schedule_work(&cb->work);
 		}
 	}
-
-	spin_unlock_irqrestore(&vc4->job_lock, irqflags);
 }
 
 static void vc4_seqno_cb_work(struct work_struct *work)
@@ -1058,7 +1073,7 @@ int vc4_queue_seqno_cb(struct drm_device *dev,
 	INIT_WORK(&cb->work, vc4_seqno_cb_work);
 
 	spin_lock_irqsave(&vc4->job_lock, irqflags);
-	if (seqno > vc4->finished_seqno) {
+	if (seqno > atomic64_read(&vc4->finished_seqno)) {
 		cb->seqno = seqno;
 		list_add_tail(&cb->work.entry, &vc4->seqno_cb_list);
 	} else {
@@ -1346,7 +1361,7 @@ static void vc4_gem_destroy(struct drm_device *dev, void *unused)
 	/* Waiting for exec to finish would need to be done before
 	 * unregistering V3D.
 	 */
-	WARN_ON(vc4->emit_seqno != vc4->finished_seqno);
+	WARN_ON(vc4->emit_seqno != atomic64_read(&vc4->finished_seqno));
 
 	/* V3D should already have disabled its interrupt and cleared
 	 * the overflow allocation registers.  Now free the object.
@@ -154,6 +154,15 @@ vc4_cancel_bin_job(struct drm_device *dev)
 	vc4_submit_next_bin_job(dev);
 }
 
+static void
+vc4_irq_account_job_latency(struct vc4_dev *vc4, struct vc4_exec_info *exec)
+{
+	s64 us = ktime_us_delta(ktime_get(), exec->submit_time);
+	unsigned int bucket = us > 0 ? fls64(us) : 0;
+
+	vc4->job_latency_hist[min(bucket, VC4_JOB_LATENCY_BUCKETS - 1)]++;
+}
+
 static void
 vc4_irq_finish_render_job(struct drm_device *dev)
 {
@@ -166,7 +175,7 @@ vc4_irq_finish_render_job(struct drm_device *dev)
 
 	trace_vc4_rcl_end_irq(dev, exec->seqno);
 
-	vc4->finished_seqno++;
+	atomic64_inc(&vc4->finished_seqno);
 	list_move_tail(&exec->head, &vc4->job_done_list);
 
 	nextbin = vc4_first_bin_job(vc4);
@@ -197,7 +206,15 @@ vc4_irq_finish_render_job(struct drm_device *dev)
 		exec->fence = NULL;
 	}
 
-	wake_up_all(&vc4->job_wait_queue);
+	vc4_irq_account_job_latency(vc4, exec);
+
+	/* Kick the seqno callbacks (async page flips) right away rather
+	 * than from job_done_work, and only take the wait queue lock if
+	 * someone is actually sleeping on a seqno.
+	 */
+	vc4_flush_seqno_cbs(vc4);
+	if (wq_has_sleeper(&vc4->job_wait_queue))
+		wake_up_all(&vc4->job_wait_queue);
 	schedule_work(&vc4->job_done_work);
 }
 
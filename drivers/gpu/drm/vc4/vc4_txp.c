@@ -12,6 +12,7 @@
 #include <linux/of_graph.h>
 #include <linux/of_platform.h>
 #include <linux/pm_runtime.h>
+#include <linux/seq_file.h>
 
 #include <drm/drm_atomic.h>
 #include <drm/drm_atomic_helper.h>
@@ -170,6 +171,21 @@ struct vc4_txp {
 	struct drm_writeback_connector connector;
 
 	void __iomem *regs;
+
+	/* Protects the job timing statistics below. */
+	spinlock_t stats_lock;
+
+	/* Time at which the job currently owned by the hardware was kicked. */
+	ktime_t job_start;
+
+	/* Number of writeback jobs completed since bind. */
+	u64 jobs_done;
+
+	/* Duration of the jobs between TXP_GO and the idle interrupt. */
+	u64 job_last_ns;
+	u64 job_min_ns;
+	u64 job_max_ns;
+	u64 job_total_ns;
 };
 
 static inline struct vc4_txp *encoder_to_vc4_txp(struct drm_encoder *encoder)
@@ -262,9 +278,15 @@ static int vc4_txp_connector_atomic_check(struct drm_connector *conn,
 
 	crtc_state = drm_atomic_get_new_crtc_state(state, conn_state->crtc);
 
+	/*
+	 * The framebuffer may be larger than the mode, in which case the
+	 * composited planes land in its top-left corner. Combined with
+	 * fb->offsets[0], this allows using the HVS and TXP to blend into
+	 * a sub-rectangle of a larger destination buffer.
+	 */
 	fb = conn_state->writeback_job->fb;
-	if (fb->width != crtc_state->mode.hdisplay ||
-	    fb->height != crtc_state->mode.vdisplay) {
+	if (fb->width < crtc_state->mode.hdisplay ||
+	    fb->height < crtc_state->mode.vdisplay) {
 		DRM_DEBUG_KMS("Invalid framebuffer size %ux%u\n",
 			      fb->width, fb->height);
 		return -EINVAL;
@@ -358,6 +380,10 @@ static void vc4_txp_connector_atomic_commit(struct drm_connector *conn,
 		  VC4_SET_FIELD(hdisplay, TXP_WIDTH) |
 		  VC4_SET_FIELD(vdisplay, TXP_HEIGHT));
 
+	spin_lock_irq(&txp->stats_lock);
+	txp->job_start = ktime_get();
+	spin_unlock_irq(&txp->stats_lock);
+
 	TXP_WRITE(TXP_DST_CTRL, ctrl);
 
 	drm_writeback_queue_job(&txp->connector, conn_state);
@@ -426,6 +452,48 @@ static int vc4_txp_enable_vblank(struct drm_crtc *crtc)
 
 static void vc4_txp_disable_vblank(struct drm_crtc *crtc) {}
 
+static int vc4_txp_jobs_show(struct seq_file *m, void *unused)
+{
+	struct drm_info_node *node = m->private;
+	struct vc4_txp *txp = node->info_ent->data;
+	u64 jobs, last, min, max, total;
+
+	spin_lock_irq(&txp->stats_lock);
+	jobs = txp->jobs_done;
+	last = txp->job_last_ns;
+	min = txp->job_min_ns;
+	max = txp->job_max_ns;
+	total = txp->job_total_ns;
+	spin_unlock_irq(&txp->stats_lock);
+
+	seq_printf(m, "jobs:\t%llu\n", jobs);
+	if (!jobs)
+		return 0;
+
+	seq_printf(m, "last:\t%llu us\n", div_u64(last, NSEC_PER_USEC));
+	seq_printf(m, "min:\t%llu us\n", div_u64(min, NSEC_PER_USEC));
+	seq_printf(m, "max:\t%llu us\n", div_u64(max, NSEC_PER_USEC));
+	seq_printf(m, "avg:\t%llu us\n",
+		   div_u64(div64_u64(total, jobs), NSEC_PER_USEC));
+
+	return 0;
+}
+
+static int vc4_txp_late_register(struct drm_crtc *crtc)
+{
+	struct drm_device *drm = crtc->dev;
+	struct vc4_crtc *vc4_crtc = to_vc4_crtc(crtc);
+	struct vc4_txp *txp = container_of(vc4_crtc, struct vc4_txp, base);
+	int ret;
+
+	ret = vc4_crtc_late_register(crtc);
+	if (ret)
+		return ret;
+
+	return vc4_debugfs_add_file(drm->primary, txp->data->jobs_debugfs_name,
+				    vc4_txp_jobs_show, txp);
+}
+
 static const struct drm_crtc_funcs vc4_txp_crtc_funcs = {
 	.set_config		= drm_atomic_helper_set_config,
 	.page_flip		= vc4_page_flip,
@@ -434,7 +502,7 @@ static const struct drm_crtc_funcs vc4_txp_crtc_funcs = {
 	.atomic_destroy_state	= vc4_crtc_destroy_state,
 	.enable_vblank		= vc4_txp_enable_vblank,
 	.disable_vblank		= vc4_txp_disable_vblank,
-	.late_register		= vc4_crtc_late_register,
+	.late_register		= vc4_txp_late_register,
 };
 
 static int vc4_txp_atomic_check(struct drm_crtc *crtc,
@@ -492,6 +560,22 @@ static const struct drm_crtc_helper_funcs vc4_txp_crtc_helper_funcs = {
 	.atomic_disable	= vc4_txp_atomic_disable,
 };
 
+static void vc4_txp_account_job(struct vc4_txp *txp)
+{
+	u64 delta;
+
+	spin_lock(&txp->stats_lock);
+	delta = ktime_to_ns(ktime_sub(ktime_get(), txp->job_start));
+	txp->job_last_ns = delta;
+	txp->job_total_ns += delta;
+	if (!txp->jobs_done || delta < txp->job_min_ns)
+		txp->job_min_ns = delta;
+	if (delta > txp->job_max_ns)
+		txp->job_max_ns = delta;
+	txp->jobs_done++;
+	spin_unlock(&txp->stats_lock);
+}
+
 static irqreturn_t vc4_txp_interrupt(int irq, void *data)
 {
 	struct vc4_txp *txp = data;
@@ -508,6 +592,7 @@ static irqreturn_t vc4_txp_interrupt(int irq, void *data)
 	 * thus always succeed if we are here.
 	 */
 	TXP_WRITE(TXP_DST_CTRL, TXP_READ(TXP_DST_CTRL) & ~TXP_EI);
+	vc4_txp_account_job(txp);
 	vc4_crtc_handle_vblank(vc4_crtc);
 	drm_writeback_signal_completion(&txp->connector, 0);
 
@@ -521,6 +606,7 @@ const struct vc4_txp_data bcm2712_mop_data = {
 		.hvs_available_channels = BIT(2),
 		.hvs_output = 2,
 	},
+	.jobs_debugfs_name = "mop_jobs",
 	.encoder_type = VC4_ENCODER_TYPE_TXP0,
 	.high_addr_ptr_reg = TXP_DST_PTR_HIGH_MOP,
 	.has_byte_enable = true,
@@ -535,6 +621,7 @@ const struct vc4_txp_data bcm2712_moplet_data = {
 		.hvs_available_channels = BIT(1),
 		.hvs_output = 4,
 	},
+	.jobs_debugfs_name = "moplet_jobs",
 	.encoder_type = VC4_ENCODER_TYPE_TXP1,
 	.high_addr_ptr_reg = TXP_DST_PTR_HIGH_MOPLET,
 	.size_minus_one = true,
@@ -548,6 +635,7 @@ const struct vc4_txp_data bcm2835_txp_data = {
 		.hvs_available_channels = BIT(2),
 		.hvs_output = 2,
 	},
+	.jobs_debugfs_name = "txp_jobs",
 	.encoder_type = VC4_ENCODER_TYPE_TXP0,
 	.has_byte_enable = true,
 };
@@ -577,6 +665,7 @@ static int vc4_txp_bind(struct device *dev, struct device *master, void *data)
 
 	txp->data = txp_data;
 	txp->pdev = pdev;
+	spin_lock_init(&txp->stats_lock);
 	txp->regs = vc4_ioremap_regs(pdev, 0);
 	if (IS_ERR(txp->regs))
 		return PTR_ERR(txp->regs);
@@ -120,6 +120,27 @@ static int vc4_v3d_debugfs_ident(struct seq_file *m, void *unused)
 	return 0;
 }
 
+static int vc4_v3d_debugfs_job_latency(struct seq_file *m, void *unused)
+{
+	struct drm_info_node *node = (struct drm_info_node *)m->private;
+	struct drm_device *dev = node->minor->dev;
+	struct vc4_dev *vc4 = to_vc4_dev(dev);
+	u32 hist[VC4_JOB_LATENCY_BUCKETS];
+	unsigned long irqflags;
+	int i;
+
+	spin_lock_irqsave(&vc4->job_lock, irqflags);
+	memcpy(hist, vc4->job_latency_hist, sizeof(hist));
+	spin_unlock_irqrestore(&vc4->job_lock, irqflags);
+
+	seq_puts(m, "submit to signal latency (us):\n");
+	for (i = 0; i < VC4_JOB_LATENCY_BUCKETS - 1; i++)
+		seq_printf(m, "< %8lu: %u\n", 1UL << i, hist[i]);
+	seq_printf(m, ">=%8lu: %u\n", 1UL << (i - 1), hist[i]);
+
+	return 0;
+}
+
 /*
  * Wraps pm_runtime_get_sync() in a refcount, so that we can reliably
  * get the pm_runtime refcount to 0 in vc4_reset().
@@ -418,6 +439,11 @@ int vc4_v3d_debugfs_init(struct drm_minor *minor)
 	if (ret)
 		return ret;
 
+	ret = vc4_debugfs_add_file(minor, "job_latency",
+				   vc4_v3d_debugfs_job_latency, NULL);
+	if (ret)
+		return ret;
+
 	return 0;
 }
 
@@ -74,6 +74,7 @@ struct aio_ring {
  * have more than the below, then don't bother setting up a plug.
  */
 #define AIO_PLUG_THRESHOLD	2
+#define AIO_COMPLETE_BATCH	16
 
 #define AIO_RING_PAGES	8
 
@@ -152,11 +153,15 @@ struct kioctx {
 	struct {
 		struct mutex	ring_lock;
 		wait_queue_head_t wait;
+		/* value of ->posted when the ring was last found empty */
+		unsigned	empty_posted;
 	} ____cacheline_aligned_in_smp;
 
 	struct {
 		unsigned	tail;
 		unsigned	completed_events;
+		/* events published to the ring so far, wraps */
+		unsigned	posted;
 		spinlock_t	completion_lock;
 	} ____cacheline_aligned_in_smp;
 
@@ -218,6 +223,17 @@ struct aio_kiocb {
 	struct eventfd_ctx	*ki_eventfd;
 };
 
+/*
+ * Requests whose last reference is dropped by io_submit() itself, i.e.
+ * that completed synchronously, are posted together: one ring update,
+ * one signal per eventfd and one wakeup for the whole batch. A batch only
+ * spans submissions that do not block, see io_submit_one().
+ */
+struct aio_complete_batch {
+	unsigned int		nr;
+	struct aio_kiocb	*reqs[AIO_COMPLETE_BATCH];
+};
+
 /*------ sysctl variables----*/
 static DEFINE_SPINLOCK(aio_nr_lock);
 static unsigned long aio_nr;		/* current system wide number of aio requests */
@@ -1109,23 +1125,15 @@ static inline void iocb_destroy(struct aio_kiocb *iocb)
 	kmem_cache_free(kiocb_cachep, iocb);
 }
 
-/* aio_complete
- *	Called when the io request on the given iocb is complete.
+/*
+ * Copy the result of @iocb into the ring slot at ctx->tail. Must be called
+ * holding ctx->completion_lock, the event becomes visible to userspace with
+ * aio_ring_commit().
  */
-static void aio_complete(struct aio_kiocb *iocb)
+static void aio_ring_add_event(struct kioctx *ctx, struct aio_kiocb *iocb)
 {
-	struct kioctx	*ctx = iocb->ki_ctx;
-	struct aio_ring	*ring;
 	struct io_event	*ev_page, *event;
-	unsigned tail, pos, head;
-	unsigned long	flags;
-
-	/*
-	 * Add a completion event to the ring buffer. Must be done holding
-	 * ctx->completion_lock to prevent other code from messing with the tail
-	 * pointer since we might be called from irq context.
-	 */
-	spin_lock_irqsave(&ctx->completion_lock, flags);
+	unsigned tail, pos;
 
 	tail = ctx->tail;
 	pos = tail + AIO_EVENTS_OFFSET;
@@ -1145,34 +1153,40 @@ static void aio_complete(struct aio_kiocb *iocb)
 		 (void __user *)(unsigned long)iocb->ki_res.obj,
 		 iocb->ki_res.data, iocb->ki_res.res, iocb->ki_res.res2);
 
+	ctx->tail = tail;
+	ctx->completed_events++;
+}
+
+/*
+ * Publish the @nr events added since the last commit, holding
+ * ctx->completion_lock.
+ */
+static void aio_ring_commit(struct kioctx *ctx, unsigned nr)
+{
+	struct aio_ring	*ring;
+	unsigned head, tail = ctx->tail;
+
 	/* after flagging the request as done, we
 	 * must never even look at it again
 	 */
 	smp_wmb();	/* make event visible before updating tail */
 
-	ctx->tail = tail;
-
 	ring = kmap_atomic(ctx->ring_pages[0]);
 	head = ring->head;
 	ring->tail = tail;
 	kunmap_atomic(ring);
 	flush_dcache_page(ctx->ring_pages[0]);
 
-	ctx->completed_events++;
+	/* pairs with the smp_rmb() in aio_read_events_ring() */
+	smp_wmb();
+	WRITE_ONCE(ctx->posted, ctx->posted + nr);
+
 	if (ctx->completed_events > 1)
 		refill_reqs_available(ctx, head, tail);
-	spin_unlock_irqrestore(&ctx->completion_lock, flags);
-
-	pr_debug("added to ring %p at [%u]\n", iocb, tail);
-
-	/*
-	 * Check if the user asked us to deliver the result through an
-	 * eventfd. The eventfd_signal() function is safe to be called
-	 * from IRQ context.
-	 */
-	if (iocb->ki_eventfd)
-		eventfd_signal(iocb->ki_eventfd, 1);
+}
 
+static void aio_wake_waiters(struct kioctx *ctx)
+{
 	/*
 	 * We have to order our ring_info tail store above and test
 	 * of the wait list below outside the wait lock.  This is
@@ -1185,6 +1199,37 @@ static void aio_complete(struct aio_kiocb *iocb)
 		wake_up(&ctx->wait);
 }
 
+/* aio_complete
+ *	Called when the io request on the given iocb is complete.
+ */
+static void aio_complete(struct aio_kiocb *iocb)
+{
+	struct kioctx	*ctx = iocb->ki_ctx;
+	unsigned long	flags;
+
+	/*
+	 * Add a completion event to the ring buffer. Must be done holding
+	 * ctx->completion_lock to prevent other code from messing with the tail
+	 * pointer since we might be called from irq context.
+	 */
+	spin_lock_irqsave(&ctx->completion_lock, flags);
+	aio_ring_add_event(ctx, iocb);
+	aio_ring_commit(ctx, 1);
+	spin_unlock_irqrestore(&ctx->completion_lock, flags);
+
+	pr_debug("added to ring %p at [%u]\n", iocb, ctx->tail);
+
+	/*
+	 * Check if the user asked us to deliver the result through an
+	 * eventfd. The eventfd_signal() function is safe to be called
+	 * from IRQ context.
+	 */
+	if (iocb->ki_eventfd)
+		eventfd_signal(iocb->ki_eventfd, 1);
+
+	aio_wake_waiters(ctx);
+}
+
 static inline void iocb_put(struct aio_kiocb *iocb)
 {
 	if (refcount_dec_and_test(&iocb->ki_refcnt)) {
@@ -1193,6 +1238,48 @@ static inline void iocb_put(struct aio_kiocb *iocb)
 	}
 }
 
+static void aio_complete_batch(struct kioctx *ctx,
+			       struct aio_complete_batch *batch)
+{
+	unsigned int i, n;
+
+	if (!batch->nr)
+		return;
+
+	spin_lock_irq(&ctx->completion_lock);
+	for (i = 0; i < batch->nr; i++)
+		aio_ring_add_event(ctx, batch->reqs[i]);
+	aio_ring_commit(ctx, batch->nr);
+	spin_unlock_irq(&ctx->completion_lock);
+
+	/* iocbs of one submission usually share their eventfd */
+	for (i = 0; i < batch->nr; i += n) {
+		struct eventfd_ctx *ev = batch->reqs[i]->ki_eventfd;
+
+		for (n = 1; i + n < batch->nr; n++)
+			if (batch->reqs[i + n]->ki_eventfd != ev)
+				break;
+		if (ev)
+			eventfd_signal(ev, n);
+	}
+
+	aio_wake_waiters(ctx);
+
+	for (i = 0; i < batch->nr; i++)
+		iocb_destroy(batch->reqs[i]);
+	batch->nr = 0;
+}
+
+static inline void iocb_put_batch(struct aio_kiocb *iocb,
+				  struct aio_complete_batch *batch)
+{
+	if (refcount_dec_and_test(&iocb->ki_refcnt)) {
+		batch->reqs[batch->nr++] = iocb;
+		if (batch->nr == AIO_COMPLETE_BATCH)
+			aio_complete_batch(iocb->ki_ctx, batch);
+	}
+}
+
 /* aio_read_events_ring
  *	Pull an event off of the ioctx's event ring.  Returns the number of
  *	events fetched
@@ -1201,10 +1288,19 @@ static long aio_read_events_ring(struct kioctx *ctx,
 				 struct io_event __user *event, long nr)
 {
 	struct aio_ring *ring;
-	unsigned head, tail, pos;
+	unsigned head, tail, pos, posted;
 	long ret = 0;
 	int copy_ret;
 
+	/*
+	 * Nothing was posted since the ring was last found empty, so skip
+	 * the ring lock. Userspace reaping from the mapped ring can only
+	 * have made it emptier.
+	 */
+	posted = READ_ONCE(ctx->posted);
+	if (posted == READ_ONCE(ctx->empty_posted))
+		return 0;
+
 	/*
 	 * The mutex can block and wake us up and that will cause
 	 * wait_event_interruptible_hrtimeout() to schedule without sleeping
@@ -1214,6 +1310,9 @@ static long aio_read_events_ring(struct kioctx *ctx,
 	sched_annotate_sleep();
 	mutex_lock(&ctx->ring_lock);
 
+	posted = READ_ONCE(ctx->posted);
+	smp_rmb();	/* see the ring tail of every event counted in posted */
+
 	/* Access to ->ring_pages here is protected by ctx->ring_lock. */
 	ring = kmap_atomic(ctx->ring_pages[0]);
 	head = ring->head;
@@ -1229,7 +1328,7 @@ static long aio_read_events_ring(struct kioctx *ctx,
 	pr_debug("h%u t%u m%u\n", head, tail, ctx->nr_events);
 
 	if (head == tail)
-		goto out;
+		goto out_empty;
 
 	head %= ctx->nr_events;
 	tail %= ctx->nr_events;
@@ -1271,6 +1370,10 @@ static long aio_read_events_ring(struct kioctx *ctx,
 	flush_dcache_page(ctx->ring_pages[0]);
 
 	pr_debug("%li  h%u t%u\n", ret, head, tail);
+	if (head != tail)
+		goto out;
+out_empty:
+	WRITE_ONCE(ctx->empty_posted, posted);
 out:
 	mutex_unlock(&ctx->ring_lock);
 
@@ -1990,11 +2093,34 @@ static int __io_submit_one(struct kioctx *ctx, const struct iocb *iocb,
 	}
 }
 
+/*
+ * Whether submitting @iocb may wait for something, possibly for userspace
+ * to act on an earlier completion, e.g. a write into a full pipe.
+ */
+static bool aio_submit_may_block(const struct iocb *iocb)
+{
+	switch (iocb->aio_lio_opcode) {
+	case IOCB_CMD_PREAD:
+	case IOCB_CMD_PWRITE:
+	case IOCB_CMD_PREADV:
+	case IOCB_CMD_PWRITEV:
+		return !(iocb->aio_rw_flags & RWF_NOWAIT);
+	case IOCB_CMD_FSYNC:
+	case IOCB_CMD_FDSYNC:
+	case IOCB_CMD_POLL:
+		/* queued to a workqueue or a waitqueue */
+		return false;
+	default:
+		return true;
+	}
+}
+
 static int io_submit_one(struct kioctx *ctx, struct iocb __user *user_iocb,
-			 bool compat)
+			 struct aio_complete_batch *batch, bool compat)
 {
 	struct aio_kiocb *req;
 	struct iocb iocb;
+	unsigned long switches;
 	int err;
 
 	if (unlikely(copy_from_user(&iocb, user_iocb, sizeof(iocb))))
@@ -2020,10 +2146,21 @@ static int io_submit_one(struct kioctx *ctx, struct iocb __user *user_iocb,
 	if (unlikely(!req))
 		return -EAGAIN;
 
+	/*
+	 * Completions held back in @batch must be visible before anything
+	 * may block, and are posted right away if the submission slept
+	 * anyway, so that a batch only merges back to back completions.
+	 */
+	if (aio_submit_may_block(&iocb))
+		aio_complete_batch(ctx, batch);
+	switches = current->nvcsw + current->nivcsw;
+
 	err = __io_submit_one(ctx, &iocb, user_iocb, req, compat);
 
 	/* Done with the synchronous reference */
-	iocb_put(req);
+	iocb_put_batch(req, batch);
+	if (current->nvcsw + current->nivcsw != switches)
+		aio_complete_batch(ctx, batch);
 
 	/*
 	 * If err is 0, we'd either done aio_complete() ourselves or have
@@ -2052,6 +2189,7 @@ static int io_submit_one(struct kioctx *ctx, struct iocb __user *user_iocb,
 SYSCALL_DEFINE3(io_submit, aio_context_t, ctx_id, long, nr,
 		struct iocb __user * __user *, iocbpp)
 {
+	struct aio_complete_batch batch = { .nr = 0 };
 	struct kioctx *ctx;
 	long ret = 0;
 	int i = 0;
@@ -2079,12 +2217,13 @@ SYSCALL_DEFINE3(io_submit, aio_context_t, ctx_id, long, nr,
 			break;
 		}
 
-		ret = io_submit_one(ctx, user_iocb, false);
+		ret = io_submit_one(ctx, user_iocb, &batch, false);
 		if (ret)
 			break;
 	}
 	if (nr > AIO_PLUG_THRESHOLD)
 		blk_finish_plug(&plug);
+	aio_complete_batch(ctx, &batch);
 
 	percpu_ref_put(&ctx->users);
 	return i ? i : ret;
@@ -2094,6 +2233,7 @@ SYSCALL_DEFINE3(io_submit, aio_context_t, ctx_id, long, nr,
 COMPAT_SYSCALL_DEFINE3(io_submit, compat_aio_context_t, ctx_id,
 		       int, nr, compat_uptr_t __user *, iocbpp)
 {
+	struct aio_complete_batch batch = { .nr = 0 };
 	struct kioctx *ctx;
 	long ret = 0;
 	int i = 0;
@@ -2121,12 +2261,13 @@ COMPAT_SYSCALL_DEFINE3(io_submit, compat_aio_context_t, ctx_id,
 			break;
 		}
 
-		ret = io_submit_one(ctx, compat_ptr(user_iocb), true);
+		ret = io_submit_one(ctx, compat_ptr(user_iocb), &batch, true);
 		if (ret)
 			break;
 	}
 	if (nr > AIO_PLUG_THRESHOLD)
 		blk_finish_plug(&plug);
+	aio_complete_batch(ctx, &batch);
 
 	percpu_ref_put(&ctx->users);
 	return i ? i : ret;
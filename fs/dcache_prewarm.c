@@ -0,0 +1,118 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Populate the dentry and inode caches from a list of paths
+ *
+ * Writing newline separated absolute paths to /proc/fs/dcache_prewarm
+ * looks them up in the background, spread over the unbound workqueue, with
+ * the credentials of the writer. Paths that do not exist leave negative
+ * dentries behind, so replaying the lookups a previous boot did, including
+ * the failed ones, saves the synchronous trips to slow media later on.
+ * Paths are resolved from the root of the initial mount namespace.
+ */
+
+#include <linux/kernel.h>
+#include <linux/fs.h>
+#include <linux/namei.h>
+#include <linux/proc_fs.h>
+#include <linux/slab.h>
+#include <linux/string.h>
+#include <linux/uaccess.h>
+#include <linux/workqueue.h>
+#include <linux/cred.h>
+#include <linux/capability.h>
+#include "internal.h"
+
+/* work items in flight before writers wait for them */
+#define PREWARM_MAX_PENDING	256
+
+struct prewarm_work {
+	struct work_struct	work;
+	const struct cred	*cred;
+	char			buf[];
+};
+
+static struct workqueue_struct *prewarm_wq;
+static atomic_t prewarm_pending = ATOMIC_INIT(0);
+
+static void prewarm_workfn(struct work_struct *work)
+{
+	struct prewarm_work *pw = container_of(work, struct prewarm_work, work);
+	const struct cred *old_cred;
+	char *p = pw->buf, *name;
+	struct path path;
+
+	old_cred = override_creds(pw->cred);
+	while ((name = strsep(&p, "\n")) != NULL) {
+		if (*name != '/')
+			continue;
+		if (!kern_path(name, LOOKUP_FOLLOW, &path))
+			path_put(&path);
+		cond_resched();
+	}
+	revert_creds(old_cred);
+
+	put_cred(pw->cred);
+	kfree(pw);
+	atomic_dec(&prewarm_pending);
+}
+
+/*
+ * Every write is looked up by its own work item, so a list streamed in
+ * page sized writes is spread over all CPUs. Only complete lines are
+ * consumed, the rest is left for the next write.
+ */
+static ssize_t prewarm_write(struct file *file, const char __user *ubuf,
+			     size_t count, loff_t *ppos)
+{
+	struct prewarm_work *pw;
+	char *nl;
+
+	if (!capable(CAP_SYS_ADMIN))
+		return -EPERM;
+
+	count = min_t(size_t, count, PATH_MAX);
+	pw = kmalloc(struct_size(pw, buf, count + 1), GFP_KERNEL);
+	if (!pw)
+		return -ENOMEM;
+	if (copy_from_user(pw->buf, ubuf, count)) {
+		kfree(pw);
+		return -EFAULT;
+	}
+	pw->buf[count] = '\0';
+
+	/*
+	 * A write without a newline is a single path, unless it is too long
+	 * to be one, in which case it is dropped.
+	 */
+	nl = strrchr(pw->buf, '\n');
+	if (nl) {
+		count = nl - pw->buf + 1;
+		*nl = '\0';
+	} else if (count == PATH_MAX) {
+		kfree(pw);
+		return count;
+	}
+
+	if (atomic_inc_return(&prewarm_pending) > PREWARM_MAX_PENDING)
+		flush_workqueue(prewarm_wq);
+
+	INIT_WORK(&pw->work, prewarm_workfn);
+	pw->cred = get_current_cred();
+	queue_work(prewarm_wq, &pw->work);
+	return count;
+}
+
+static const struct proc_ops prewarm_proc_ops = {
+	.proc_write	= prewarm_write,
+	.proc_lseek	= noop_llseek,
+};
+
+static int __init dcache_prewarm_init(void)
+{
+	prewarm_wq = alloc_workqueue("dcache_prewarm", WQ_UNBOUND, 0);
+	if (!prewarm_wq)
+		return -ENOMEM;
+	proc_create("fs/dcache_prewarm", 0200, NULL, &prewarm_proc_ops);
+	return 0;
+}
+fs_initcall(dcache_prewarm_init);
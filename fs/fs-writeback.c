@@ -29,6 +29,7 @@
 #include <linux/tracepoint.h>
 #include <linux/device.h>
 #include <linux/memcontrol.h>
+#include <linux/sysctl.h>
 #include "internal.h"
 
 /*
@@ -67,6 +68,15 @@ struct wb_writeback_work {
  */
 unsigned int dirtytime_expire_interval = 12 * 60 * 60;
 
+/*
+ * Bound, in centiseconds, on how long dirty data may sit in memory before
+ * it reaches the device. When set, the flusher keeps each wb's dirty
+ * backlog below what its measured write bandwidth clears in that time, so
+ * a slow SD card or USB stick starts writeback with a far smaller backlog
+ * than a fast disk. Zero leaves the global dirty_* policies alone.
+ */
+static unsigned int dirty_latency_interval;
+
 static inline struct inode *wb_inode(struct list_head *head)
 {
 	return list_entry(head, struct inode, i_io_list);
@@ -140,6 +150,71 @@ static void wb_wakeup(struct bdi_writeback *wb)
 	spin_unlock_irq(&wb->work_lock);
 }
 
+/*
+ * Period of kupdate-style flushing: dirty_writeback_interval, or half the
+ * latency bound if that is shorter.
+ */
+static unsigned int wb_flush_interval(void)
+{
+	unsigned int interval = dirty_writeback_interval;
+	unsigned int latency = READ_ONCE(dirty_latency_interval);
+
+	latency = DIV_ROUND_UP(latency, 2);
+	if (latency && (!interval || latency < interval))
+		interval = latency;
+	return interval;
+}
+
+/*
+ * Age after which kupdate-style writeback picks up dirty inodes. Half of
+ * the latency bound is left for the writeback itself.
+ */
+static unsigned int wb_expire_interval(void)
+{
+	unsigned int latency = READ_ONCE(dirty_latency_interval);
+
+	if (latency)
+		return min(dirty_expire_interval, DIV_ROUND_UP(latency, 2));
+	return dirty_expire_interval;
+}
+
+static void wb_wakeup_periodic(struct bdi_writeback *wb)
+{
+	unsigned long timeout;
+
+	if (!READ_ONCE(dirty_latency_interval)) {
+		wb_wakeup_delayed(wb);
+		return;
+	}
+
+	timeout = msecs_to_jiffies(wb_flush_interval() * 10);
+	spin_lock_irq(&wb->work_lock);
+	if (test_bit(WB_registered, &wb->state))
+		queue_delayed_work(bdi_wq, &wb->dwork, timeout);
+	spin_unlock_irq(&wb->work_lock);
+}
+
+/*
+ * Is the dirty backlog of @wb larger than what it can write back within
+ * the latency bound at its average write bandwidth?
+ */
+static bool wb_over_latency_limit(struct bdi_writeback *wb)
+{
+	unsigned int latency = READ_ONCE(dirty_latency_interval);
+	unsigned long dirty, limit;
+
+	if (!latency)
+		return false;
+
+	dirty = wb_stat(wb, WB_RECLAIMABLE);
+	limit = div_u64((u64)wb->avg_write_bandwidth * latency, 100);
+	if (dirty <= limit)
+		return false;
+
+	trace_writeback_latency_limit(wb, dirty, limit);
+	return true;
+}
+
 static void finish_writeback_work(struct bdi_writeback *wb,
 				  struct wb_writeback_work *work)
 {
@@ -2053,9 +2128,10 @@ static long wb_writeback(struct bdi_writeback *wb,
 
 		/*
 		 * For background writeout, stop when we are below the
-		 * background dirty threshold
+		 * background dirty threshold and the latency limit
 		 */
-		if (work->for_background && !wb_over_bg_thresh(wb))
+		if (work->for_background && !wb_over_bg_thresh(wb) &&
+		    !wb_over_latency_limit(wb))
 			break;
 
 		/*
@@ -2066,7 +2142,7 @@ static long wb_writeback(struct bdi_writeback *wb,
 		 */
 		if (work->for_kupdate) {
 			dirtied_before = jiffies -
-				msecs_to_jiffies(dirty_expire_interval * 10);
+				msecs_to_jiffies(wb_expire_interval() * 10);
 		} else if (work->for_background)
 			dirtied_before = jiffies;
 
@@ -2132,7 +2208,7 @@ static struct wb_writeback_work *get_next_work_item(struct bdi_writeback *wb)
 
 static long wb_check_background_flush(struct bdi_writeback *wb)
 {
-	if (wb_over_bg_thresh(wb)) {
+	if (wb_over_bg_thresh(wb) || wb_over_latency_limit(wb)) {
 
 		struct wb_writeback_work work = {
 			.nr_pages	= LONG_MAX,
@@ -2150,17 +2226,17 @@ static long wb_check_background_flush(struct bdi_writeback *wb)
 
 static long wb_check_old_data_flush(struct bdi_writeback *wb)
 {
+	unsigned int interval = wb_flush_interval();
 	unsigned long expired;
 	long nr_pages;
 
 	/*
 	 * When set to zero, disable periodic writeback
 	 */
-	if (!dirty_writeback_interval)
+	if (!interval)
 		return 0;
 
-	expired = wb->last_old_flush +
-			msecs_to_jiffies(dirty_writeback_interval * 10);
+	expired = wb->last_old_flush + msecs_to_jiffies(interval * 10);
 	if (time_before(jiffies, expired))
 		return 0;
 
@@ -2273,8 +2349,8 @@ void wb_workfn(struct work_struct *work)
 
 	if (!list_empty(&wb->work_list))
 		wb_wakeup(wb);
-	else if (wb_has_dirty_io(wb) && dirty_writeback_interval)
-		wb_wakeup_delayed(wb);
+	else if (wb_has_dirty_io(wb) && wb_flush_interval())
+		wb_wakeup_periodic(wb);
 }
 
 /*
@@ -2371,6 +2447,26 @@ int dirtytime_interval_handler(struct ctl_table *table, int write,
 	return ret;
 }
 
+#ifdef CONFIG_SYSCTL
+static struct ctl_table vm_writeback_sysctls[] = {
+	{
+		.procname	= "dirty_latency_centisecs",
+		.data		= &dirty_latency_interval,
+		.maxlen		= sizeof(dirty_latency_interval),
+		.mode		= 0644,
+		.proc_handler	= proc_douintvec,
+	},
+	{ }
+};
+
+static int __init writeback_sysctls_init(void)
+{
+	register_sysctl_init("vm", vm_writeback_sysctls);
+	return 0;
+}
+__initcall(writeback_sysctls_init);
+#endif
+
 /**
  * __mark_inode_dirty -	internal function to mark an inode dirty
  *
@@ -2526,7 +2622,7 @@ void __mark_inode_dirty(struct inode *inode, int flags)
 			 */
 			if (wakeup_bdi &&
 			    (wb->bdi->capabilities & BDI_CAP_WRITEBACK))
-				wb_wakeup_delayed(wb);
+				wb_wakeup_periodic(wb);
 			return;
 		}
 	}
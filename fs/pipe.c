@@ -59,6 +59,15 @@ static unsigned int pipe_max_size = 1048576;
 static unsigned long pipe_user_pages_hard;
 static unsigned long pipe_user_pages_soft = PIPE_DEF_BUFFERS * INR_OPEN_CUR;
 
+/*
+ * Largest folio order (up to 3) a single pipe buffer may use for big writes,
+ * set in /proc/sys/fs/pipe-folio-order. Zero keeps every buffer at one page.
+ * A pipe picks it up when created or resized, and is charged for every slot
+ * holding a folio of that order, falling back to single pages when that
+ * would exceed the pipe-max-size or pipe-user-pages-* limits.
+ */
+static unsigned int pipe_folio_order;
+
 /*
  * We use head and tail indices that aren't masked off, except at the point of
  * dereference, but rather they're allowed to wrap naturally.  This means there
@@ -122,20 +131,70 @@ void pipe_double_lock(struct pipe_inode_info *pipe1,
 	}
 }
 
-static void anon_pipe_buf_release(struct pipe_inode_info *pipe,
-				  struct pipe_buffer *buf)
+static struct page *anon_pipe_get_page(struct pipe_inode_info *pipe,
+				       unsigned int order)
 {
-	struct page *page = buf->page;
+	struct page *page;
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(pipe->tmp_page); i++) {
+		page = pipe->tmp_page[i];
+		if (page && compound_order(page) == order) {
+			pipe->tmp_page[i] = NULL;
+			return page;
+		}
+	}
 
 	/*
-	 * If nobody else uses this page, and we don't already have a
-	 * temporary page, let's keep track of it as a one-deep
-	 * allocation cache. (Otherwise just release our reference to it)
+	 * Multi-page buffers come from lowmem so that users mapping the
+	 * buffer page with kmap() see the whole buffer; fall back to a
+	 * single page rather than trying hard.
 	 */
-	if (page_count(page) == 1 && !pipe->tmp_page)
-		pipe->tmp_page = page;
-	else
-		put_page(page);
+	if (order) {
+		page = alloc_pages(GFP_USER | __GFP_ACCOUNT | __GFP_COMP |
+				   __GFP_NORETRY | __GFP_NOWARN, order);
+		if (page)
+			return page;
+	}
+	return alloc_page(GFP_HIGHUSER | __GFP_ACCOUNT);
+}
+
+/*
+ * If nobody else uses this page, keep it in the small per-pipe allocation
+ * cache, preferring it over a smaller cached page. (Otherwise just release
+ * our reference to it) Pages larger than the pipe is now charged for are
+ * not kept.
+ */
+static void anon_pipe_put_page(struct pipe_inode_info *pipe,
+			       struct page *page)
+{
+	unsigned int order = compound_order(page);
+	int i, victim = -1;
+
+	if (page_count(page) == 1 && order <= pipe->folio_order) {
+		for (i = 0; i < ARRAY_SIZE(pipe->tmp_page); i++) {
+			struct page *cached = pipe->tmp_page[i];
+
+			if (!cached) {
+				pipe->tmp_page[i] = page;
+				return;
+			}
+			if (compound_order(cached) < order)
+				victim = i;
+		}
+		if (victim >= 0) {
+			put_page(pipe->tmp_page[victim]);
+			pipe->tmp_page[victim] = page;
+			return;
+		}
+	}
+	put_page(page);
+}
+
+static void anon_pipe_buf_release(struct pipe_inode_info *pipe,
+				  struct pipe_buffer *buf)
+{
+	anon_pipe_put_page(pipe, buf->page);
 }
 
 static bool anon_pipe_buf_try_steal(struct pipe_inode_info *pipe,
@@ -143,7 +202,8 @@ static bool anon_pipe_buf_try_steal(struct pipe_inode_info *pipe,
 {
 	struct page *page = buf->page;
 
-	if (page_count(page) != 1)
+	/* multi-page buffers are never handed over to other owners */
+	if (page_count(page) != 1 || PageCompound(page))
 		return false;
 	memcg_kmem_uncharge_page(page, 0);
 	__SetPageLocked(page);
@@ -412,6 +472,22 @@ static inline bool pipe_writable(const struct pipe_inode_info *pipe)
 		!READ_ONCE(pipe->readers);
 }
 
+/*
+ * Pick the buffer size for the next chunk of a write: the largest allowed
+ * order that the remaining data fills completely.
+ */
+static unsigned int pipe_buf_order(struct pipe_inode_info *pipe,
+				   struct file *filp, struct iov_iter *from)
+{
+	unsigned int order = pipe->folio_order;
+
+	if (is_packetized(filp))
+		return 0;
+	while (order && iov_iter_count(from) < (PAGE_SIZE << order))
+		order--;
+	return order;
+}
+
 static ssize_t
 pipe_write(struct kiocb *iocb, struct iov_iter *from)
 {
@@ -460,7 +536,7 @@ pipe_write(struct kiocb *iocb, struct iov_iter *from)
 		int offset = buf->offset + buf->len;
 
 		if ((buf->flags & PIPE_BUF_FLAG_CAN_MERGE) &&
-		    offset + chars <= PAGE_SIZE) {
+		    offset + chars <= page_size(buf->page)) {
 			ret = pipe_buf_confirm(pipe, buf);
 			if (ret)
 				goto out;
@@ -489,17 +565,17 @@ pipe_write(struct kiocb *iocb, struct iov_iter *from)
 		if (!pipe_full(head, pipe->tail, pipe->max_usage)) {
 			unsigned int mask = pipe->ring_size - 1;
 			struct pipe_buffer *buf = &pipe->bufs[head & mask];
-			struct page *page = pipe->tmp_page;
+			struct page *page;
+			size_t size;
 			int copied;
 
-			if (!page) {
-				page = alloc_page(GFP_HIGHUSER | __GFP_ACCOUNT);
-				if (unlikely(!page)) {
-					ret = ret ? : -ENOMEM;
-					break;
-				}
-				pipe->tmp_page = page;
+			page = anon_pipe_get_page(pipe,
+						  pipe_buf_order(pipe, filp, from));
+			if (unlikely(!page)) {
+				ret = ret ? : -ENOMEM;
+				break;
 			}
+			size = page_size(page);
 
 			/* Allocate a slot in the ring in advance and attach an
 			 * empty buffer.  If we fault or otherwise fail to use
@@ -511,6 +587,7 @@ pipe_write(struct kiocb *iocb, struct iov_iter *from)
 			head = pipe->head;
 			if (pipe_full(head, pipe->tail, pipe->max_usage)) {
 				spin_unlock_irq(&pipe->rd_wait.lock);
+				anon_pipe_put_page(pipe, page);
 				continue;
 			}
 
@@ -527,10 +604,9 @@ pipe_write(struct kiocb *iocb, struct iov_iter *from)
 				buf->flags = PIPE_BUF_FLAG_PACKET;
 			else
 				buf->flags = PIPE_BUF_FLAG_CAN_MERGE;
-			pipe->tmp_page = NULL;
 
-			copied = copy_page_from_iter(page, 0, PAGE_SIZE, from);
-			if (unlikely(copied < PAGE_SIZE && iov_iter_count(from))) {
+			copied = copy_page_from_iter(page, 0, size, from);
+			if (unlikely(copied < size && iov_iter_count(from))) {
 				if (!ret)
 					ret = -EFAULT;
 				break;
@@ -786,6 +862,7 @@ struct pipe_inode_info *alloc_pipe_info(void)
 	struct user_struct *user = get_current_user();
 	unsigned long user_bufs;
 	unsigned int max_size = READ_ONCE(pipe_max_size);
+	unsigned int order = READ_ONCE(pipe_folio_order);
 
 	pipe = kzalloc(sizeof(struct pipe_inode_info), GFP_KERNEL_ACCOUNT);
 	if (pipe == NULL)
@@ -794,7 +871,19 @@ struct pipe_inode_info *alloc_pipe_info(void)
 	if (pipe_bufs * PAGE_SIZE > max_size && !capable(CAP_SYS_RESOURCE))
 		pipe_bufs = max_size >> PAGE_SHIFT;
 
-	user_bufs = account_pipe_buffers(user, 0, pipe_bufs);
+	if (((pipe_bufs * PAGE_SIZE) << order) > max_size &&
+	    !capable(CAP_SYS_RESOURCE))
+		order = 0;
+
+	user_bufs = account_pipe_buffers(user, 0, pipe_bufs << order);
+
+	if (order && (too_many_pipe_buffers_soft(user_bufs) ||
+		      too_many_pipe_buffers_hard(user_bufs)) &&
+	    pipe_is_unprivileged_user()) {
+		user_bufs = account_pipe_buffers(user, pipe_bufs << order,
+						 pipe_bufs);
+		order = 0;
+	}
 
 	if (too_many_pipe_buffers_soft(user_bufs) && pipe_is_unprivileged_user()) {
 		user_bufs = account_pipe_buffers(user, pipe_bufs, PIPE_MIN_DEF_BUFFERS);
@@ -813,14 +902,15 @@ struct pipe_inode_info *alloc_pipe_info(void)
 		pipe->r_counter = pipe->w_counter = 1;
 		pipe->max_usage = pipe_bufs;
 		pipe->ring_size = pipe_bufs;
-		pipe->nr_accounted = pipe_bufs;
+		pipe->nr_accounted = pipe_bufs << order;
+		pipe->folio_order = order;
 		pipe->user = user;
 		mutex_init(&pipe->mutex);
 		return pipe;
 	}
 
 out_revert_acct:
-	(void) account_pipe_buffers(user, pipe_bufs, 0);
+	(void) account_pipe_buffers(user, pipe_bufs << order, 0);
 	kfree(pipe);
 out_free_uid:
 	free_uid(user);
@@ -847,8 +937,10 @@ void free_pipe_info(struct pipe_inode_info *pipe)
 	if (pipe->watch_queue)
 		put_watch_queue(pipe->watch_queue);
 #endif
-	if (pipe->tmp_page)
-		__free_page(pipe->tmp_page);
+	for (i = 0; i < ARRAY_SIZE(pipe->tmp_page); i++) {
+		if (pipe->tmp_page[i])
+			put_page(pipe->tmp_page[i]);
+	}
 	kfree(pipe->bufs);
 	kfree(pipe);
 }
@@ -1310,6 +1402,41 @@ int pipe_resize_ring(struct pipe_inode_info *pipe, unsigned int nr_slots)
 	return 0;
 }
 
+/*
+ * Highest folio order among the buffers the pipe allocated itself that are
+ * still in the ring. A resize must keep charging for them until they are
+ * read.
+ */
+static unsigned int pipe_held_order(struct pipe_inode_info *pipe)
+{
+	unsigned int mask = pipe->ring_size - 1;
+	unsigned int head = pipe->head;
+	unsigned int tail, order = 0;
+
+	for (tail = pipe->tail; tail != head; tail++) {
+		struct pipe_buffer *buf = &pipe->bufs[tail & mask];
+
+		if (buf->ops == &anon_pipe_buf_ops)
+			order = max(order, compound_order(buf->page));
+	}
+	return order;
+}
+
+/* Release cached pages larger than the pipe is charged for */
+static void pipe_trim_tmp_pages(struct pipe_inode_info *pipe)
+{
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(pipe->tmp_page); i++) {
+		struct page *page = pipe->tmp_page[i];
+
+		if (page && compound_order(page) > pipe->folio_order) {
+			put_page(page);
+			pipe->tmp_page[i] = NULL;
+		}
+	}
+}
+
 /*
  * Allocate a new array of pipe buffers and copy the info over. Returns the
  * pipe size if successful, or return -ERROR on error.
@@ -1318,6 +1445,8 @@ static long pipe_set_size(struct pipe_inode_info *pipe, unsigned long arg)
 {
 	unsigned long user_bufs;
 	unsigned int nr_slots, size;
+	unsigned int order = READ_ONCE(pipe_folio_order);
+	unsigned int held;
 	long ret = 0;
 
 #ifdef CONFIG_WATCH_QUEUE
@@ -1342,7 +1471,27 @@ static long pipe_set_size(struct pipe_inode_info *pipe, unsigned long arg)
 			size > pipe_max_size && !capable(CAP_SYS_RESOURCE))
 		return -EPERM;
 
-	user_bufs = account_pipe_buffers(pipe->user, pipe->nr_accounted, nr_slots);
+	/*
+	 * Larger folios may be dropped when over a limit, but not below the
+	 * order of those still queued, or the charge would not cover them.
+	 */
+	held = pipe_held_order(pipe);
+	order = max(order, held);
+
+	if (order > held && ((unsigned long)size << order) > pipe_max_size &&
+	    !capable(CAP_SYS_RESOURCE))
+		order = held;
+
+	user_bufs = account_pipe_buffers(pipe->user, pipe->nr_accounted,
+					 nr_slots << order);
+
+	if (order > held && (too_many_pipe_buffers_hard(user_bufs) ||
+			     too_many_pipe_buffers_soft(user_bufs)) &&
+	    pipe_is_unprivileged_user()) {
+		user_bufs = account_pipe_buffers(pipe->user, nr_slots << order,
+						 nr_slots << held);
+		order = held;
+	}
 
 	if (nr_slots > pipe->max_usage &&
 			(too_many_pipe_buffers_hard(user_bufs) ||
@@ -1357,11 +1506,14 @@ static long pipe_set_size(struct pipe_inode_info *pipe, unsigned long arg)
 		goto out_revert_acct;
 
 	pipe->max_usage = nr_slots;
-	pipe->nr_accounted = nr_slots;
+	pipe->nr_accounted = nr_slots << order;
+	pipe->folio_order = order;
+	pipe_trim_tmp_pages(pipe);
 	return pipe->max_usage * PAGE_SIZE;
 
 out_revert_acct:
-	(void) account_pipe_buffers(pipe->user, nr_slots, pipe->nr_accounted);
+	(void) account_pipe_buffers(pipe->user, nr_slots << order,
+				    pipe->nr_accounted);
 	return ret;
 }
 
@@ -1487,6 +1639,15 @@ static struct ctl_table fs_pipe_sysctls[] = {
 		.mode		= 0644,
 		.proc_handler	= proc_doulongvec_minmax,
 	},
+	{
+		.procname	= "pipe-folio-order",
+		.data		= &pipe_folio_order,
+		.maxlen		= sizeof(pipe_folio_order),
+		.mode		= 0644,
+		.proc_handler	= proc_douintvec_minmax,
+		.extra1		= SYSCTL_ZERO,
+		.extra2		= SYSCTL_THREE,
+	},
 	{ }
 };
 #endif
@@ -73,6 +73,9 @@ struct inode *ramfs_get_inode(struct super_block *sb,
 		case S_IFREG:
 			inode->i_op = &ramfs_file_inode_operations;
 			inode->i_fop = &ramfs_file_operations;
+			/* nommu keeps file pages contiguous, don't move in */
+			if (IS_ENABLED(CONFIG_MMU))
+				mapping_set_splice_move(inode->i_mapping);
 			break;
 		case S_IFDIR:
 			inode->i_op = &ramfs_dir_inode_operations;
@@ -596,6 +596,106 @@ ssize_t splice_from_pipe(struct pipe_inode_info *pipe, struct file *out,
 	return ret;
 }
 
+/*
+ * Move a whole, page aligned pipe buffer into the page cache of @out instead
+ * of copying it. Only pages that nobody else references and that the VM has
+ * no other use for qualify, in practice the pages write(2) fills a pipe
+ * with. Returns true if the buffer page is now owned by the page cache.
+ */
+static bool pipe_buf_move_to_file(struct pipe_inode_info *pipe,
+				  struct pipe_buffer *buf, struct file *out,
+				  loff_t pos)
+{
+	struct address_space *mapping = out->f_mapping;
+	struct inode *inode = mapping->host;
+	struct folio *folio = page_folio(buf->page);
+	bool kmem;
+
+	if (pos + PAGE_SIZE > inode->i_sb->s_maxbytes ||
+	    pos + PAGE_SIZE > rlimit(RLIMIT_FSIZE))
+		return false;
+
+	/*
+	 * Check before stealing: ->try_steal() of page cache buffers drops
+	 * the page from its file, and that of anonymous pipe buffers
+	 * uncharges it. Neither should happen for a page we can't use.
+	 */
+	if (folio_test_large(folio) || folio->mapping || folio_test_lru(folio) ||
+	    folio_test_swapbacked(folio) || folio_ref_count(folio) != 1 ||
+	    (folio_memcg(folio) && !folio_memcg_kmem(folio)))
+		return false;
+
+	kmem = folio_memcg_kmem(folio);
+	if (!pipe_buf_try_steal(pipe, buf))
+		return false;
+
+	/* on failure filemap_add_folio() has already cleared the lock bit */
+	if (filemap_add_folio(mapping, folio, pos >> PAGE_SHIFT,
+			      mapping_gfp_constraint(mapping, GFP_KERNEL))) {
+		/* the page stays in the pipe, put its pipe charge back */
+		if (kmem && !folio_memcg_kmem(folio))
+			memcg_kmem_charge_page(&folio->page, GFP_KERNEL, 0);
+		return false;
+	}
+
+	folio_mark_uptodate(folio);
+	folio_mark_dirty(folio);
+	folio_unlock(folio);
+
+	if (pos + PAGE_SIZE > i_size_read(inode))
+		i_size_write(inode, pos + PAGE_SIZE);
+	return true;
+}
+
+static bool splice_can_move(struct pipe_inode_info *pipe,
+			    struct splice_desc *sd)
+{
+	struct pipe_buffer *buf = &pipe->bufs[pipe->tail & (pipe->ring_size - 1)];
+
+	return sd->total_len >= PAGE_SIZE && !offset_in_page(sd->pos) &&
+	       !buf->offset && buf->len == PAGE_SIZE;
+}
+
+/*
+ * Move as many leading pipe buffers as possible into @out. Returns the
+ * number of bytes moved, or a negative error if nothing was.
+ */
+static ssize_t splice_move_to_file(struct pipe_inode_info *pipe,
+				   struct splice_desc *sd, struct file *out)
+{
+	struct inode *inode = file_inode(out);
+	unsigned int mask = pipe->ring_size - 1;
+	ssize_t moved = 0;
+	int ret;
+
+	inode_lock(inode);
+	ret = file_modified(out);
+	if (ret)
+		goto out;
+
+	while (!pipe_empty(pipe->head, pipe->tail) && splice_can_move(pipe, sd)) {
+		struct pipe_buffer *buf = &pipe->bufs[pipe->tail & mask];
+
+		if (pipe_buf_confirm(pipe, buf) ||
+		    !pipe_buf_move_to_file(pipe, buf, out, sd->pos))
+			break;
+
+		buf->len = 0;
+		pipe_buf_release(pipe, buf);
+		pipe->tail++;
+		if (pipe->files)
+			sd->need_wakeup = true;
+
+		sd->pos += PAGE_SIZE;
+		sd->num_spliced += PAGE_SIZE;
+		sd->total_len -= PAGE_SIZE;
+		moved += PAGE_SIZE;
+	}
+out:
+	inode_unlock(inode);
+	return moved ? moved : ret;
+}
+
 /**
  * iter_file_splice_write - splice data from a pipe to a file
  * @pipe:	pipe info
@@ -607,7 +707,9 @@ ssize_t splice_from_pipe(struct pipe_inode_info *pipe, struct file *out,
  * Description:
  *    Will either move or copy pages (determined by @flags options) from
  *    the given pipe inode to the given file.
- *    This one is ->write_iter-based.
+ *    This one is ->write_iter-based. With %SPLICE_F_MOVE, whole pages are
+ *    moved into the page cache if the mapping allows it, see
+ *    mapping_set_splice_move().
  *
  */
 ssize_t
@@ -623,6 +725,10 @@ iter_file_splice_write(struct pipe_inode_info *pipe, struct file *out,
 	int nbufs = pipe->max_usage;
 	struct bio_vec *array = kcalloc(nbufs, sizeof(struct bio_vec),
 					GFP_KERNEL);
+	bool move = (flags & SPLICE_F_MOVE) &&
+		    mapping_splice_move(out->f_mapping) &&
+		    !(out->f_flags & (O_APPEND | O_DIRECT | O_DSYNC)) &&
+		    !IS_SYNC(file_inode(out));
 	ssize_t ret;
 
 	if (unlikely(!array))
@@ -641,6 +747,15 @@ iter_file_splice_write(struct pipe_inode_info *pipe, struct file *out,
 		if (ret <= 0)
 			break;
 
+		if (move && splice_can_move(pipe, &sd)) {
+			ret = splice_move_to_file(pipe, &sd, out);
+			if (ret < 0)
+				break;
+			*ppos = sd.pos;
+			if (ret)
+				continue;
+		}
+
 		if (unlikely(nbufs < pipe->max_usage)) {
 			kfree(array);
 			nbufs = pipe->max_usage;
@@ -35,6 +35,7 @@ struct timerfd_ctx {
 	} t;
 	ktime_t tintv;
 	ktime_t moffs;
+	u64 slot;			/* coarse timer slot, 0 if precise */
 	wait_queue_head_t wqh;
 	u64 ticks;
 	int clockid;
@@ -186,6 +187,58 @@ static ktime_t timerfd_get_remaining(struct timerfd_ctx *ctx)
 	return remaining < 0 ? 0: remaining;
 }
 
+/*
+ * A coarse timer may fire up to one slot late, the slot being the timer
+ * slack of the task arming it. The hard expiry is rounded up to a slot
+ * boundary so that coarse timers with overlapping ranges share a single
+ * expiry, and thus a single hrtimer interrupt.
+ */
+static u64 timerfd_coarse_delta(struct timerfd_ctx *ctx, ktime_t texp)
+{
+	u64 rem;
+
+	if (!ctx->slot || texp <= 0)
+		return 0;
+	div64_u64_rem(texp, ctx->slot, &rem);
+	return rem ? ctx->slot - rem : 0;
+}
+
+static void timerfd_start_coarse(struct timerfd_ctx *ctx, ktime_t texp,
+				 enum hrtimer_mode htmode)
+{
+	ctx->slot = current->timer_slack_ns;
+	if (htmode == HRTIMER_MODE_REL)
+		texp = ktime_add_safe(hrtimer_cb_get_time(&ctx->t.tmr), texp);
+
+	hrtimer_start_range_ns(&ctx->t.tmr, texp,
+			       timerfd_coarse_delta(ctx, texp),
+			       HRTIMER_MODE_ABS);
+}
+
+/*
+ * hrtimer_forward() counts overruns from the hard expiry, but a coarse
+ * timer may run anywhere in its range, so forward it from the soft expiry
+ * or a run before the hard one would count no tick at all. Forwarding also
+ * takes the hard expiry off the slot grid unless the interval is a
+ * multiple of the slot, so realign it on every period.
+ */
+static u64 timerfd_hrtimer_forward_now(struct timerfd_ctx *ctx)
+{
+	struct hrtimer *tmr = &ctx->t.tmr;
+	ktime_t texp;
+	u64 orun;
+
+	if (!ctx->slot)
+		return hrtimer_forward_now(tmr, ctx->tintv);
+
+	hrtimer_set_expires(tmr, hrtimer_get_softexpires(tmr));
+	orun = hrtimer_forward_now(tmr, ctx->tintv);
+	texp = hrtimer_get_softexpires(tmr);
+	hrtimer_set_expires_range_ns(tmr, texp,
+				     timerfd_coarse_delta(ctx, texp));
+	return orun;
+}
+
 static int timerfd_setup(struct timerfd_ctx *ctx, int flags,
 			 const struct itimerspec64 *ktmr)
 {
@@ -200,6 +253,7 @@ static int timerfd_setup(struct timerfd_ctx *ctx, int flags,
 	ctx->expired = 0;
 	ctx->ticks = 0;
 	ctx->tintv = timespec64_to_ktime(ktmr->it_interval);
+	ctx->slot = 0;
 
 	if (isalarm(ctx)) {
 		alarm_init(&ctx->t.alarm,
@@ -220,6 +274,8 @@ static int timerfd_setup(struct timerfd_ctx *ctx, int flags,
 				alarm_start(&ctx->t.alarm, texp);
 			else
 				alarm_start_relative(&ctx->t.alarm, texp);
+		} else if (flags & TFD_TIMER_COARSE) {
+			timerfd_start_coarse(ctx, texp, htmode);
 		} else {
 			hrtimer_start(&ctx->t.tmr, texp, htmode);
 		}
@@ -303,8 +359,7 @@ static ssize_t timerfd_read(struct file *file, char __user *buf, size_t count,
 					&ctx->t.alarm, ctx->tintv) - 1;
 				alarm_restart(&ctx->t.alarm);
 			} else {
-				ticks += hrtimer_forward_now(&ctx->t.tmr,
-							     ctx->tintv) - 1;
+				ticks += timerfd_hrtimer_forward_now(ctx) - 1;
 				hrtimer_restart(&ctx->t.tmr);
 			}
 		}
@@ -507,7 +562,7 @@ static int do_timerfd_settime(int ufd, int flags,
 		if (isalarm(ctx))
 			alarm_forward_now(&ctx->t.alarm, ctx->tintv);
 		else
-			hrtimer_forward_now(&ctx->t.tmr, ctx->tintv);
+			timerfd_hrtimer_forward_now(ctx);
 	}
 
 	old->it_value = ktime_to_timespec64(timerfd_get_remaining(ctx));
@@ -542,9 +597,7 @@ static int do_timerfd_gettime(int ufd, struct itimerspec64 *t)
 					&ctx->t.alarm, ctx->tintv) - 1;
 			alarm_restart(&ctx->t.alarm);
 		} else {
-			ctx->ticks +=
-				hrtimer_forward_now(&ctx->t.tmr, ctx->tintv)
-				- 1;
+			ctx->ticks += timerfd_hrtimer_forward_now(ctx) - 1;
 			hrtimer_restart(&ctx->t.tmr);
 		}
 	}
@@ -15,6 +15,7 @@ struct drm_master;
 struct drm_vblank_crtc;
 struct drm_vma_offset_manager;
 struct drm_vram_mm;
+struct drm_gem_dma_pool;
 struct drm_fb_helper;
 
 struct inode;
@@ -277,6 +278,9 @@ struct drm_device {
 	/** @vram_mm: VRAM MM memory manager */
 	struct drm_vram_mm *vram_mm;
 
+	/** @dma_pool: Reserved pool for GEM DMA objects */
+	struct drm_gem_dma_pool *dma_pool;
+
 	/**
 	 * @switch_power_state:
 	 *
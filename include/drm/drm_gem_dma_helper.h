@@ -17,6 +17,8 @@ struct drm_mode_create_dumb;
  *       DMA addresses.
  * @vaddr: kernel virtual address of the backing memory
  * @map_noncoherent: if true, the GEM object is backed by non-coherent memory
+ * @pooled: if true, the backing memory comes from the device's reserved pool
+ * @pool_blocks: buddy blocks making up the backing memory of pooled objects
  */
 struct drm_gem_dma_object {
 	struct drm_gem_object base;
@@ -27,6 +29,9 @@ struct drm_gem_dma_object {
 	void *vaddr;
 
 	bool map_noncoherent;
+
+	bool pooled;
+	struct list_head pool_blocks;
 };
 
 #define to_drm_gem_dma_obj(gem_obj) \
@@ -35,6 +40,7 @@ struct drm_gem_dma_object {
 struct drm_gem_dma_object *drm_gem_dma_create(struct drm_device *drm,
 					      size_t size);
 void drm_gem_dma_free(struct drm_gem_dma_object *dma_obj);
+void drm_gem_dma_free_buffer(struct drm_gem_dma_object *dma_obj);
 void drm_gem_dma_print_info(const struct drm_gem_dma_object *dma_obj,
 			    struct drm_printer *p, unsigned int indent);
 struct sg_table *drm_gem_dma_get_sg_table(struct drm_gem_dma_object *dma_obj);
@@ -44,6 +50,9 @@ int drm_gem_dma_mmap(struct drm_gem_dma_object *dma_obj, struct vm_area_struct *
 
 extern const struct vm_operations_struct drm_gem_dma_vm_ops;
 
+int drmm_gem_dma_pool_init(struct drm_device *drm, size_t size);
+void drm_gem_dma_pool_print_info(struct drm_device *drm, struct drm_printer *p);
+
 /*
  * GEM object functions
  */
@@ -107,6 +107,8 @@ struct bpf_map_ops {
 	u32 (*map_fd_sys_lookup_elem)(void *ptr);
 	void (*map_seq_show_elem)(struct bpf_map *map, void *key,
 				  struct seq_file *m);
+	void (*map_show_fdinfo)(const struct bpf_map *map,
+				struct seq_file *m);
 	int (*map_check_btf)(const struct bpf_map *map,
 			     const struct btf *btf,
 			     const struct btf_type *key_type,
@@ -1182,6 +1184,8 @@ struct bpf_prog_aux {
 	struct bpf_prog *prog;
 	struct user_struct *user;
 	u64 load_time; /* ns since boottime */
+	u64 verif_time_ns; /* time spent in bpf_check() */
+	u64 jit_time_ns; /* time spent in bpf_prog_select_runtime() */
 	u32 verified_insns;
 	int cgroup_atype; /* enum cgroup_bpf_attach_type */
 	struct bpf_map *cgroup_storage[MAX_BPF_CGROUP_STORAGE_TYPE];
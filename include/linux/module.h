@@ -349,6 +349,9 @@ struct mod_kallsyms {
 	unsigned int num_symtab;
 	char *strtab;
 	char *typetab;
+	/* Indices of the named symbols in symtab, sorted by address. */
+	unsigned int *addrtab;
+	unsigned int num_addrtab;
 };
 
 #ifdef CONFIG_LIVEPATCH
@@ -521,6 +521,27 @@ static inline bool napi_complete(struct napi_struct *n)
 
 int dev_set_threaded(struct net_device *dev, bool threaded);
 
+/*
+ * Boot time switch moving softirq work to per-CPU threads. It is set by a
+ * "<name>[=<SCHED_FIFO priority>]" early parameter and always on with
+ * PREEMPT_RT; without a priority the threads stay SCHED_NORMAL. Used by
+ * "thread_backlog_napi" for the RPS backlog and by "tcp_tsq_threads" for
+ * TCP small queues and pacing.
+ */
+struct net_threads_param {
+	struct static_key_false	key;
+	int			prio;
+};
+
+#define DEFINE_NET_THREADS_PARAM(name)					\
+	struct net_threads_param name = { .key = STATIC_KEY_FALSE_INIT }
+
+#define net_threads_enabled(param)					\
+	(IS_ENABLED(CONFIG_PREEMPT_RT) || static_branch_unlikely(&(param)->key))
+
+int net_threads_param_setup(struct net_threads_param *param, char *arg);
+void net_threads_set_prio(const struct net_threads_param *param);
+
 /**
  *	napi_disable - prevent NAPI from scheduling
  *	@n: NAPI context
@@ -202,6 +202,7 @@ enum mapping_flags {
 	AS_RELEASE_ALWAYS,	/* Call ->release_folio(), even if no private data */
 	AS_STABLE_WRITES,	/* must wait for writeback before modifying
 				   folio contents */
+	AS_SPLICE_MOVE,		/* splice may move pipe pages into the cache */
 };
 
 /**
@@ -297,6 +298,20 @@ static inline void mapping_set_stable_writes(struct address_space *mapping)
 	set_bit(AS_STABLE_WRITES, &mapping->flags);
 }
 
+static inline bool mapping_splice_move(const struct address_space *mapping)
+{
+	return test_bit(AS_SPLICE_MOVE, &mapping->flags);
+}
+
+/*
+ * Only set this on mappings whose folios need no filesystem state beyond
+ * being uptodate and dirty, splice inserts them without ->write_begin().
+ */
+static inline void mapping_set_splice_move(struct address_space *mapping)
+{
+	set_bit(AS_SPLICE_MOVE, &mapping->flags);
+}
+
 static inline void mapping_clear_stable_writes(struct address_space *mapping)
 {
 	clear_bit(AS_STABLE_WRITES, &mapping->flags);
@@ -42,7 +42,8 @@ struct pipe_buffer {
  *	@max_usage: The maximum number of slots that may be used in the ring
  *	@ring_size: total number of buffers (should be a power of 2)
  *	@nr_accounted: The amount this pipe accounts for in user->pipe_bufs
- *	@tmp_page: cached released page
+ *	@folio_order: largest folio order of buffers written, charged in @nr_accounted
+ *	@tmp_page: cached released pages
  *	@readers: number of current readers of this pipe
  *	@writers: number of current writers of this pipe
  *	@files: number of struct file referring this pipe (protected by ->i_lock)
@@ -66,13 +67,14 @@ struct pipe_inode_info {
 	bool note_loss;
 #endif
 	unsigned int nr_accounted;
+	unsigned int folio_order;
 	unsigned int readers;
 	unsigned int writers;
 	unsigned int files;
 	unsigned int r_counter;
 	unsigned int w_counter;
 	bool poll_usage;
-	struct page *tmp_page;
+	struct page *tmp_page[2];
 	struct fasync_struct *fasync_readers;
 	struct fasync_struct *fasync_writers;
 	struct pipe_buffer *bufs;
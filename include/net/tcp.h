@@ -2270,6 +2270,7 @@ static inline void tcp_listendrop(const struct sock *sk)
 }
 
 enum hrtimer_restart tcp_pace_kick(struct hrtimer *timer);
+enum hrtimer_mode tcp_pacing_timer_mode(void);
 
 /*
  * Interface for adding Upper Level Protocols over TCP
@@ -618,6 +618,39 @@ TRACE_EVENT(bdi_dirty_ratelimit,
 	)
 );
 
+TRACE_EVENT(writeback_latency_limit,
+
+	TP_PROTO(struct bdi_writeback *wb,
+		 unsigned long dirty,
+		 unsigned long limit),
+
+	TP_ARGS(wb, dirty, limit),
+
+	TP_STRUCT__entry(
+		__array(char,		bdi, 32)
+		__field(unsigned long,	avg_write_bw)
+		__field(unsigned long,	dirty)
+		__field(unsigned long,	limit)
+		__field(ino_t,		cgroup_ino)
+	),
+
+	TP_fast_assign(
+		strscpy_pad(__entry->bdi, bdi_dev_name(wb->bdi), 32);
+		__entry->avg_write_bw	= KBps(wb->avg_write_bandwidth);
+		__entry->dirty		= dirty;
+		__entry->limit		= limit;
+		__entry->cgroup_ino	= __trace_wb_assign_cgroup(wb);
+	),
+
+	TP_printk("bdi %s: awrite_bw=%lu dirty=%lu limit=%lu cgroup_ino=%lu",
+		  __entry->bdi,
+		  __entry->avg_write_bw,	/* avg write bandwidth */
+		  __entry->dirty,		/* wb dirty pages */
+		  __entry->limit,		/* pages writable within bound */
+		  (unsigned long)__entry->cgroup_ino
+	)
+);
+
 TRACE_EVENT(balance_dirty_pages,
 
 	TP_PROTO(struct bdi_writeback *wb,
@@ -6102,6 +6102,8 @@ struct bpf_cpumap_val {
 		int   fd;	/* prog fd on map write */
 		__u32 id;	/* prog id on map read */
 	} bpf_prog;
+	__u32 batch;	/* frames handled per kthread iteration, 0 = default */
+	__u32 rt_prio;	/* SCHED_FIFO priority of the kthread, 0 = SCHED_OTHER */
 };
 
 enum sk_action {
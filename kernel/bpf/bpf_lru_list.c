@@ -19,6 +19,9 @@
 #define LOCAL_PENDING_LIST_IDX	LOCAL_LIST_IDX(BPF_LRU_LOCAL_LIST_T_PENDING)
 #define IS_LOCAL_LIST_TYPE(t)	((t) >= BPF_LOCAL_LIST_T_OFFSET)
 
+#define bpf_lru_stat_inc(lru, field)	this_cpu_inc((lru)->stats->field)
+#define bpf_lru_stat_add(lru, field, n)	this_cpu_add((lru)->stats->field, (n))
+
 static int get_next_cpu(int cpu)
 {
 	cpu = cpumask_next(cpu, cpu_possible_mask);
@@ -233,6 +236,8 @@ __bpf_lru_list_shrink_inactive(struct bpf_lru *lru,
 			break;
 	}
 
+	bpf_lru_stat_add(lru, evictions, nshrinked);
+
 	return nshrinked;
 }
 
@@ -241,6 +246,8 @@ __bpf_lru_list_shrink_inactive(struct bpf_lru *lru,
  */
 static void __bpf_lru_list_rotate(struct bpf_lru *lru, struct bpf_lru_list *l)
 {
+	bpf_lru_stat_inc(lru, rotations);
+
 	if (bpf_lru_list_inactive_low(l))
 		__bpf_lru_list_rotate_active(lru, l);
 
@@ -266,7 +273,7 @@ static unsigned int __bpf_lru_list_shrink(struct bpf_lru *lru,
 {
 	struct bpf_lru_node *node, *tmp_node;
 	struct list_head *force_shrink_list;
-	unsigned int nshrinked;
+	unsigned int nshrinked, i = 0;
 
 	nshrinked = __bpf_lru_list_shrink_inactive(lru, l, tgt_nshrink,
 						   free_list, tgt_free_type);
@@ -284,8 +291,15 @@ static unsigned int __bpf_lru_list_shrink(struct bpf_lru *lru,
 		if (lru->del_from_htab(lru->del_arg, node)) {
 			__bpf_lru_node_move_to_free(l, node, free_list,
 						    tgt_free_type);
+			bpf_lru_stat_inc(lru, evictions);
 			return 1;
 		}
+
+		/* Bound the time spent under l->lock, the caller will
+		 * fall back to stealing.
+		 */
+		if (++i == lru->nr_scans)
+			break;
 	}
 
 	return 0;
@@ -329,9 +343,9 @@ static void bpf_lru_list_pop_free_to_local(struct bpf_lru *lru,
 
 	raw_spin_lock(&l->lock);
 
-	__local_list_flush(l, loc_l);
+	bpf_lru_stat_inc(lru, refills);
 
-	__bpf_lru_list_rotate(lru, l);
+	__local_list_flush(l, loc_l);
 
 	list_for_each_entry_safe(node, tmp_node, &l->lists[BPF_LRU_LIST_T_FREE],
 				 list) {
@@ -341,10 +355,17 @@ static void bpf_lru_list_pop_free_to_local(struct bpf_lru *lru,
 			break;
 	}
 
-	if (nfree < LOCAL_FREE_TARGET)
+	/* The active/inactive ordering only matters once something has
+	 * to be evicted.  Defer the rotation until then, so that refills
+	 * served from the global free list do not pay for up to
+	 * 2 * nr_scans list moves while holding l->lock.
+	 */
+	if (nfree < LOCAL_FREE_TARGET) {
+		__bpf_lru_list_rotate(lru, l);
 		__bpf_lru_list_shrink(lru, l, LOCAL_FREE_TARGET - nfree,
 				      local_free_list(loc_l),
 				      BPF_LRU_LOCAL_LIST_T_FREE);
+	}
 
 	raw_spin_unlock(&l->lock);
 }
@@ -381,16 +402,25 @@ __local_list_pop_pending(struct bpf_lru *lru, struct bpf_lru_locallist *loc_l)
 {
 	struct bpf_lru_node *node;
 	bool force = false;
+	unsigned int i = 0;
 
 ignore_ref:
-	/* Get from the tail (i.e. older element) of the pending list. */
+	/* Get from the tail (i.e. older element) of the pending list.
+	 * The search for an unreferenced node is bounded by nr_scans, so
+	 * a remote CPU's pending list is never walked in full while its
+	 * lock is held with irqs off.
+	 */
 	list_for_each_entry_reverse(node, local_pending_list(loc_l),
 				    list) {
 		if ((!bpf_lru_node_is_ref(node) || force) &&
 		    lru->del_from_htab(lru->del_arg, node)) {
 			list_del(&node->list);
+			bpf_lru_stat_inc(lru, evictions);
 			return node;
 		}
+
+		if (!force && ++i == lru->nr_scans)
+			break;
 	}
 
 	if (!force) {
@@ -414,18 +444,20 @@ static struct bpf_lru_node *bpf_percpu_lru_pop_free(struct bpf_lru *lru,
 
 	raw_spin_lock_irqsave(&l->lock, flags);
 
-	__bpf_lru_list_rotate(lru, l);
-
 	free_list = &l->lists[BPF_LRU_LIST_T_FREE];
-	if (list_empty(free_list))
+	if (list_empty(free_list)) {
+		__bpf_lru_list_rotate(lru, l);
 		__bpf_lru_list_shrink(lru, l, PERCPU_FREE_TARGET, free_list,
 				      BPF_LRU_LIST_T_FREE);
+	}
 
 	if (!list_empty(free_list)) {
 		node = list_first_entry(free_list, struct bpf_lru_node, list);
 		*(u32 *)((void *)node + lru->hash_offset) = hash;
 		bpf_lru_node_clear_ref(node);
 		__bpf_lru_node_move(l, node, BPF_LRU_LIST_T_INACTIVE);
+	} else {
+		bpf_lru_stat_inc(lru, failures);
 	}
 
 	raw_spin_unlock_irqrestore(&l->lock, flags);
@@ -439,7 +471,7 @@ static struct bpf_lru_node *bpf_common_lru_pop_free(struct bpf_lru *lru,
 	struct bpf_lru_locallist *loc_l, *steal_loc_l;
 	struct bpf_common_lru *clru = &lru->common_lru;
 	struct bpf_lru_node *node;
-	int steal, first_steal;
+	int steal, first_steal, victim;
 	unsigned long flags;
 	int cpu = raw_smp_processor_id();
 
@@ -482,15 +514,21 @@ static struct bpf_lru_node *bpf_common_lru_pop_free(struct bpf_lru *lru,
 
 		raw_spin_unlock_irqrestore(&steal_loc_l->lock, flags);
 
+		victim = steal;
 		steal = get_next_cpu(steal);
 	} while (!node && steal != first_steal);
 
 	loc_l->next_steal = steal;
 
 	if (node) {
+		/* Taking back our own pending nodes is not a steal */
+		if (victim != cpu)
+			bpf_lru_stat_inc(lru, steals);
 		raw_spin_lock_irqsave(&loc_l->lock, flags);
 		__local_list_add_pending(lru, loc_l, cpu, node, hash);
 		raw_spin_unlock_irqrestore(&loc_l->lock, flags);
+	} else {
+		bpf_lru_stat_inc(lru, failures);
 	}
 
 	return node;
@@ -653,10 +691,14 @@ int bpf_lru_init(struct bpf_lru *lru, bool percpu, u32 hash_offset,
 {
 	int cpu;
 
+	lru->stats = alloc_percpu(struct bpf_lru_stats);
+	if (!lru->stats)
+		return -ENOMEM;
+
 	if (percpu) {
 		lru->percpu_lru = alloc_percpu(struct bpf_lru_list);
 		if (!lru->percpu_lru)
-			return -ENOMEM;
+			goto free_stats;
 
 		for_each_possible_cpu(cpu) {
 			struct bpf_lru_list *l;
@@ -670,7 +712,7 @@ int bpf_lru_init(struct bpf_lru *lru, bool percpu, u32 hash_offset,
 
 		clru->local_list = alloc_percpu(struct bpf_lru_locallist);
 		if (!clru->local_list)
-			return -ENOMEM;
+			goto free_stats;
 
 		for_each_possible_cpu(cpu) {
 			struct bpf_lru_locallist *loc_l;
@@ -689,6 +731,10 @@ int bpf_lru_init(struct bpf_lru *lru, bool percpu, u32 hash_offset,
 	lru->hash_offset = hash_offset;
 
 	return 0;
+
+free_stats:
+	free_percpu(lru->stats);
+	return -ENOMEM;
 }
 
 void bpf_lru_destroy(struct bpf_lru *lru)
@@ -697,4 +743,22 @@ void bpf_lru_destroy(struct bpf_lru *lru)
 		free_percpu(lru->percpu_lru);
 	else
 		free_percpu(lru->common_lru.local_list);
+	free_percpu(lru->stats);
+}
+
+void bpf_lru_get_stats(const struct bpf_lru *lru, struct bpf_lru_stats *stats)
+{
+	int cpu;
+
+	memset(stats, 0, sizeof(*stats));
+
+	for_each_possible_cpu(cpu) {
+		const struct bpf_lru_stats *s = per_cpu_ptr(lru->stats, cpu);
+
+		stats->refills += READ_ONCE(s->refills);
+		stats->rotations += READ_ONCE(s->rotations);
+		stats->evictions += READ_ONCE(s->evictions);
+		stats->steals += READ_ONCE(s->steals);
+		stats->failures += READ_ONCE(s->failures);
+	}
 }
@@ -43,6 +43,14 @@ struct bpf_lru_locallist {
 	raw_spinlock_t lock;
 };
 
+struct bpf_lru_stats {
+	u64 refills;		/* trips to the global LRU list */
+	u64 rotations;		/* active/inactive list rotations */
+	u64 evictions;		/* nodes taken back from the htab */
+	u64 steals;		/* nodes taken from another CPU's list */
+	u64 failures;		/* bpf_lru_pop_free() found nothing */
+};
+
 struct bpf_common_lru {
 	struct bpf_lru_list lru_list;
 	struct bpf_lru_locallist __percpu *local_list;
@@ -57,6 +65,7 @@ struct bpf_lru {
 	};
 	del_from_htab_func del_from_htab;
 	void *del_arg;
+	struct bpf_lru_stats __percpu *stats;
 	unsigned int hash_offset;
 	unsigned int nr_scans;
 	bool percpu;
@@ -76,5 +85,6 @@ void bpf_lru_destroy(struct bpf_lru *lru);
 struct bpf_lru_node *bpf_lru_pop_free(struct bpf_lru *lru, u32 hash);
 void bpf_lru_push_free(struct bpf_lru *lru, struct bpf_lru_node *node);
 void bpf_lru_promote(struct bpf_lru *lru, struct bpf_lru_node *node);
+void bpf_lru_get_stats(const struct bpf_lru *lru, struct bpf_lru_stats *stats);
 
 #endif
@@ -23,6 +23,7 @@
 #include <net/xdp.h>
 
 #include <linux/sched.h>
+#include <linux/sched/prio.h>
 #include <linux/workqueue.h>
 #include <linux/kthread.h>
 #include <linux/capability.h>
@@ -32,6 +33,8 @@
 
 #include <linux/netdevice.h>   /* netif_receive_skb_list */
 #include <linux/etherdevice.h> /* eth_type_trans */
+#include <net/gro.h>
+#include <uapi/linux/sched/types.h>
 
 /* General idea: XDP packets getting XDP redirected to another CPU,
  * will maximum be stored/queued for one driver ->poll() call.  It is
@@ -65,6 +68,17 @@ struct bpf_cpu_map_entry {
 	struct ptr_ring *queue;
 	struct task_struct *kthread;
 
+	/* Per-iteration scratch arrays of value.batch entries each, only
+	 * touched by the kthread.
+	 */
+	void **frames;
+	void **skbs;
+
+	/* GRO context of the kthread.  It is never registered with a
+	 * net_device or scheduled, only its GRO lists are used.
+	 */
+	struct napi_struct napi;
+
 	struct bpf_cpumap_val value;
 	struct bpf_prog *prog;
 
@@ -95,7 +109,8 @@ static struct bpf_map *cpu_map_alloc(union bpf_attr *attr)
 	/* check sanity of attributes */
 	if (attr->max_entries == 0 || attr->key_size != 4 ||
 	    (value_size != offsetofend(struct bpf_cpumap_val, qsize) &&
-	     value_size != offsetofend(struct bpf_cpumap_val, bpf_prog.fd)) ||
+	     value_size != offsetofend(struct bpf_cpumap_val, bpf_prog.fd) &&
+	     value_size != offsetofend(struct bpf_cpumap_val, rt_prio)) ||
 	    attr->map_flags & ~BPF_F_NUMA_NODE)
 		return ERR_PTR(-EINVAL);
 
@@ -158,6 +173,7 @@ static void put_cpu_map_entry(struct bpf_cpu_map_entry *rcpu)
 		__cpu_map_ring_cleanup(rcpu->queue);
 		ptr_ring_cleanup(rcpu->queue, NULL);
 		kfree(rcpu->queue);
+		kfree(rcpu->frames);
 		kfree(rcpu);
 	}
 }
@@ -278,6 +294,7 @@ static int cpu_map_bpf_prog_run_xdp(struct bpf_cpu_map_entry *rcpu,
 }
 
 #define CPUMAP_BATCH 8
+#define CPUMAP_BATCH_MAX 64
 
 static int cpu_map_bpf_prog_run(struct bpf_cpu_map_entry *rcpu, void **frames,
 				int xdp_n, struct xdp_cpumap_stats *stats,
@@ -303,9 +320,25 @@ static int cpu_map_bpf_prog_run(struct bpf_cpu_map_entry *rcpu, void **frames,
 	return nframes;
 }
 
+static void cpu_map_gro_init(struct napi_struct *napi)
+{
+	int i;
+
+	for (i = 0; i < GRO_HASH_BUCKETS; i++) {
+		INIT_LIST_HEAD(&napi->gro_hash[i].list);
+		napi->gro_hash[i].count = 0;
+	}
+	napi->gro_bitmask = 0;
+	INIT_LIST_HEAD(&napi->rx_list);
+	napi->rx_count = 0;
+}
+
 static int cpu_map_kthread_run(void *data)
 {
 	struct bpf_cpu_map_entry *rcpu = data;
+	unsigned int batch = rcpu->value.batch;
+	void **frames = rcpu->frames;
+	void **skbs = rcpu->skbs;
 
 	complete(&rcpu->kthread_running);
 	set_current_state(TASK_INTERRUPTIBLE);
@@ -320,8 +353,7 @@ static int cpu_map_kthread_run(void *data)
 		unsigned int kmem_alloc_drops = 0, sched = 0;
 		gfp_t gfp = __GFP_ZERO | GFP_ATOMIC;
 		int i, n, m, nframes, xdp_n;
-		void *frames[CPUMAP_BATCH];
-		void *skbs[CPUMAP_BATCH];
+		struct sk_buff *gro_skb, *tmp;
 		LIST_HEAD(list);
 
 		/* Release CPU reschedule checks */
@@ -343,8 +375,7 @@ static int cpu_map_kthread_run(void *data)
 		 * kthread CPU pinned. Lockless access to ptr_ring
 		 * consume side valid as no-resize allowed of queue.
 		 */
-		n = __ptr_ring_consume_batched(rcpu->queue, frames,
-					       CPUMAP_BATCH);
+		n = __ptr_ring_consume_batched(rcpu->queue, frames, batch);
 		for (i = 0, xdp_n = 0; i < n; i++) {
 			void *f = frames[i];
 			struct page *page;
@@ -392,7 +423,19 @@ static int cpu_map_kthread_run(void *data)
 
 			list_add_tail(&skb->list, &list);
 		}
-		netif_receive_skb_list(&list);
+
+		list_for_each_entry_safe(gro_skb, tmp, &list, list) {
+			skb_list_del_init(gro_skb);
+			napi_gro_receive(&rcpu->napi, gro_skb);
+		}
+
+		/* Keep aggregating while more frames are queued, like a NAPI
+		 * poll that used its whole budget.  Everything held is
+		 * flushed before the kthread can go to sleep or exit.
+		 */
+		if (__ptr_ring_empty(rcpu->queue))
+			napi_gro_flush(&rcpu->napi, false);
+		gro_normal_list(&rcpu->napi);
 
 		/* Feedback loop via tracepoint */
 		trace_xdp_cpumap_kthread(rcpu->map_id, n, kmem_alloc_drops,
@@ -464,12 +507,22 @@ __cpu_map_entry_alloc(struct bpf_map *map, struct bpf_cpumap_val *value,
 	if (err)
 		goto free_queue;
 
+	rcpu->value.batch = min_t(u32, value->batch ? : CPUMAP_BATCH,
+				  value->qsize);
+	rcpu->frames = bpf_map_kmalloc_node(map, 2 * rcpu->value.batch *
+					    sizeof(void *), gfp, numa);
+	if (!rcpu->frames)
+		goto free_ptr_ring;
+	rcpu->skbs = rcpu->frames + rcpu->value.batch;
+	cpu_map_gro_init(&rcpu->napi);
+
 	rcpu->cpu    = cpu;
 	rcpu->map_id = map->id;
 	rcpu->value.qsize  = value->qsize;
+	rcpu->value.rt_prio = value->rt_prio;
 
 	if (fd > 0 && __cpu_map_load_bpf_program(rcpu, map, fd))
-		goto free_ptr_ring;
+		goto free_frames;
 
 	/* Setup kthread */
 	init_completion(&rcpu->kthread_running);
@@ -479,6 +532,13 @@ __cpu_map_entry_alloc(struct bpf_map *map, struct bpf_cpumap_val *value,
 	if (IS_ERR(rcpu->kthread))
 		goto free_prog;
 
+	/* Let the kthread compete with threaded NAPI on RT systems */
+	if (value->rt_prio) {
+		struct sched_param param = { .sched_priority = value->rt_prio };
+
+		sched_setscheduler_nocheck(rcpu->kthread, SCHED_FIFO, &param);
+	}
+
 	get_cpu_map_entry(rcpu); /* 1-refcnt for being in cmap->cpu_map[] */
 	get_cpu_map_entry(rcpu); /* 1-refcnt for kthread */
 
@@ -497,6 +557,8 @@ __cpu_map_entry_alloc(struct bpf_map *map, struct bpf_cpumap_val *value,
 free_prog:
 	if (rcpu->prog)
 		bpf_prog_put(rcpu->prog);
+free_frames:
+	kfree(rcpu->frames);
 free_ptr_ring:
 	ptr_ring_cleanup(rcpu->queue, NULL);
 free_queue:
@@ -588,6 +650,11 @@ static int cpu_map_update_elem(struct bpf_map *map, void *key, void *value,
 		return -EEXIST;
 	if (unlikely(cpumap_value.qsize > 16384)) /* sanity limit on qsize */
 		return -EOVERFLOW;
+	if (unlikely(cpumap_value.batch > CPUMAP_BATCH_MAX ||
+		     cpumap_value.rt_prio >= MAX_RT_PRIO))
+		return -EINVAL;
+	if (cpumap_value.rt_prio && !capable(CAP_SYS_NICE))
+		return -EPERM;
 
 	/* Make sure CPU is a valid possible cpu */
 	if (key_cpu >= nr_cpumask_bits || !cpu_possible(key_cpu))
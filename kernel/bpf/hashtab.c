@@ -2212,6 +2212,24 @@ const struct bpf_map_ops htab_map_ops = {
 	.iter_seq_info = &iter_seq_info,
 };
 
+static void htab_lru_map_show_fdinfo(const struct bpf_map *map,
+				     struct seq_file *m)
+{
+	struct bpf_htab *htab = container_of(map, struct bpf_htab, map);
+	struct bpf_lru_stats stats;
+
+	bpf_lru_get_stats(&htab->lru, &stats);
+
+	seq_printf(m,
+		   "lru_refills:\t%llu\n"
+		   "lru_rotations:\t%llu\n"
+		   "lru_evictions:\t%llu\n"
+		   "lru_steals:\t%llu\n"
+		   "lru_failures:\t%llu\n",
+		   stats.refills, stats.rotations, stats.evictions,
+		   stats.steals, stats.failures);
+}
+
 const struct bpf_map_ops htab_lru_map_ops = {
 	.map_meta_equal = bpf_map_meta_equal,
 	.map_alloc_check = htab_map_alloc_check,
@@ -2226,6 +2244,7 @@ const struct bpf_map_ops htab_lru_map_ops = {
 	.map_delete_elem = htab_lru_map_delete_elem,
 	.map_gen_lookup = htab_lru_map_gen_lookup,
 	.map_seq_show_elem = htab_map_seq_show_elem,
+	.map_show_fdinfo = htab_lru_map_show_fdinfo,
 	.map_set_for_each_callback_args = map_set_for_each_callback_args,
 	.map_for_each_callback = bpf_for_each_hash_elem,
 	BATCH_OPS(htab_lru),
@@ -2396,6 +2415,7 @@ const struct bpf_map_ops htab_lru_percpu_map_ops = {
 	.map_delete_elem = htab_lru_map_delete_elem,
 	.map_lookup_percpu_elem = htab_lru_percpu_map_lookup_percpu_elem,
 	.map_seq_show_elem = htab_percpu_map_seq_show_elem,
+	.map_show_fdinfo = htab_lru_map_show_fdinfo,
 	.map_set_for_each_callback_args = map_set_for_each_callback_args,
 	.map_for_each_callback = bpf_for_each_hash_elem,
 	BATCH_OPS(htab_lru_percpu),
@@ -155,29 +155,35 @@ static inline int extract_bit(const u8 *data, size_t index)
 }
 
 /**
- * longest_prefix_match() - determine the longest prefix
+ * __longest_prefix_match() - determine the longest prefix
  * @trie:	The trie to get internal sizes from
  * @node:	The node to operate on
  * @key:	The key to compare to @node
+ * @known:	Number of leading bits already known to match
  *
- * Determine the longest prefix of @node that matches the bits in @key.
+ * Determine the longest prefix of @node that matches the bits in @key,
+ * skipping the whole 32-bit words covered by @known.
  */
-static size_t longest_prefix_match(const struct lpm_trie *trie,
-				   const struct lpm_trie_node *node,
-				   const struct bpf_lpm_trie_key *key)
+static size_t __longest_prefix_match(const struct lpm_trie *trie,
+				     const struct lpm_trie_node *node,
+				     const struct bpf_lpm_trie_key *key,
+				     u32 known)
 {
 	u32 limit = min(node->prefixlen, key->prefixlen);
-	u32 prefixlen = 0, i = 0;
+	u32 prefixlen, i;
 
 	BUILD_BUG_ON(offsetof(struct lpm_trie_node, data) % sizeof(u32));
 	BUILD_BUG_ON(offsetof(struct bpf_lpm_trie_key, data) % sizeof(u32));
 
+	i = min_t(u32, known / 32 * 4, trie->data_size & ~3);
+	prefixlen = i * 8;
+
 #if defined(CONFIG_HAVE_EFFICIENT_UNALIGNED_ACCESS) && defined(CONFIG_64BIT)
 
 	/* data_size >= 16 has very small probability.
 	 * We do not use a loop for optimal code generation.
 	 */
-	if (trie->data_size >= 8) {
+	if (trie->data_size >= 8 && i == 0) {
 		u64 diff = be64_to_cpu(*(__be64 *)node->data ^
 				       *(__be64 *)key->data);
 
@@ -224,12 +230,28 @@ static size_t longest_prefix_match(const struct lpm_trie *trie,
 	return prefixlen;
 }
 
+/**
+ * longest_prefix_match() - determine the longest prefix
+ * @trie:	The trie to get internal sizes from
+ * @node:	The node to operate on
+ * @key:	The key to compare to @node
+ *
+ * Determine the longest prefix of @node that matches the bits in @key.
+ */
+static size_t longest_prefix_match(const struct lpm_trie *trie,
+				   const struct lpm_trie_node *node,
+				   const struct bpf_lpm_trie_key *key)
+{
+	return __longest_prefix_match(trie, node, key, 0);
+}
+
 /* Called from syscall or from eBPF program */
 static void *trie_lookup_elem(struct bpf_map *map, void *_key)
 {
 	struct lpm_trie *trie = container_of(map, struct lpm_trie, map);
 	struct lpm_trie_node *node, *found = NULL;
 	struct bpf_lpm_trie_key *key = _key;
+	u32 known = 0;
 
 	/* Start walking the trie from the root node ... */
 
@@ -241,8 +263,14 @@ static void *trie_lookup_elem(struct bpf_map *map, void *_key)
 		/* Determine the longest prefix of @node that matches @key.
 		 * If it's the maximum possible prefix for this trie, we have
 		 * an exact match and can return it directly.
+		 *
+		 * Every node shares its parent's prefix, which @key has
+		 * already been checked against, so only the words past it
+		 * need comparing.  This matters for IPv6 keys, which
+		 * would otherwise be compared from the first word at
+		 * every level.
 		 */
-		matchlen = longest_prefix_match(trie, node, key);
+		matchlen = __longest_prefix_match(trie, node, key, known);
 		if (matchlen == trie->max_prefixlen) {
 			found = node;
 			break;
@@ -265,6 +293,7 @@ static void *trie_lookup_elem(struct bpf_map *map, void *_key)
 		 * become more specific. Determine the next bit in the key and
 		 * traverse down.
 		 */
+		known = node->prefixlen;
 		next_bit = extract_bit(key->data, node->prefixlen);
 		node = rcu_dereference_check(node->child[next_bit],
 					     rcu_read_lock_bh_held());
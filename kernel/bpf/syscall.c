@@ -729,6 +729,8 @@ static void bpf_map_show_fdinfo(struct seq_file *m, struct file *filp)
 		seq_printf(m, "owner_prog_type:\t%u\n", type);
 		seq_printf(m, "owner_jited:\t%u\n", jited);
 	}
+	if (map->ops->map_show_fdinfo)
+		map->ops->map_show_fdinfo(map, m);
 }
 #endif
 
@@ -2147,7 +2149,9 @@ static void bpf_prog_show_fdinfo(struct seq_file *m, struct file *filp)
 		   "run_time_ns:\t%llu\n"
 		   "run_cnt:\t%llu\n"
 		   "recursion_misses:\t%llu\n"
-		   "verified_insns:\t%u\n",
+		   "verified_insns:\t%u\n"
+		   "verif_time_ns:\t%llu\n"
+		   "jit_time_ns:\t%llu\n",
 		   prog->type,
 		   prog->jited,
 		   prog_tag,
@@ -2156,7 +2160,9 @@ static void bpf_prog_show_fdinfo(struct seq_file *m, struct file *filp)
 		   stats.nsecs,
 		   stats.cnt,
 		   stats.misses,
-		   prog->aux->verified_insns);
+		   prog->aux->verified_insns,
+		   prog->aux->verif_time_ns,
+		   prog->aux->jit_time_ns);
 }
 #endif
 
@@ -2463,6 +2469,7 @@ static int bpf_prog_load(union bpf_attr *attr, bpfptr_t uattr)
 	enum bpf_prog_type type = attr->prog_type;
 	struct bpf_prog *prog, *dst_prog = NULL;
 	struct btf *attach_btf = NULL;
+	u64 start_time;
 	int err;
 	char license[128];
 	bool is_gpl;
@@ -2604,9 +2611,11 @@ static int bpf_prog_load(union bpf_attr *attr, bpfptr_t uattr)
 	if (err < 0)
 		goto free_used_maps;
 
+	start_time = ktime_get_ns();
 	prog = bpf_prog_select_runtime(prog, &err);
 	if (err < 0)
 		goto free_used_maps;
+	prog->aux->jit_time_ns = ktime_get_ns() - start_time;
 
 	err = bpf_prog_alloc_id(prog);
 	if (err)
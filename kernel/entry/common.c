@@ -38,10 +38,12 @@ void noinstr enter_from_user_mode(struct pt_regs *regs)
 static inline void syscall_enter_audit(struct pt_regs *regs, long syscall)
 {
 	if (unlikely(audit_context())) {
+		struct entry_work_stamp start = entry_work_stats_start();
 		unsigned long args[6];
 
 		syscall_get_arguments(current, regs, args);
 		audit_syscall_entry(syscall, args[0], args[1], args[2], args[3]);
+		entry_work_stats_account(ENTRY_STAT_AUDIT, start);
 	}
 }
 
@@ -49,6 +51,7 @@ static long syscall_trace_enter(struct pt_regs *regs, long syscall,
 				unsigned long work)
 {
 	long ret = 0;
+	struct entry_work_stamp start;
 
 	/*
 	 * Handle Syscall User Dispatch.  This must comes first, since
@@ -56,20 +59,29 @@ static long syscall_trace_enter(struct pt_regs *regs, long syscall,
 	 * other syscall_work features.
 	 */
 	if (work & SYSCALL_WORK_SYSCALL_USER_DISPATCH) {
-		if (syscall_user_dispatch(regs))
+		bool dispatched;
+
+		start = entry_work_stats_start();
+		dispatched = syscall_user_dispatch(regs);
+		entry_work_stats_account(ENTRY_STAT_USER_DISPATCH, start);
+		if (dispatched)
 			return -1L;
 	}
 
 	/* Handle ptrace */
 	if (work & (SYSCALL_WORK_SYSCALL_TRACE | SYSCALL_WORK_SYSCALL_EMU)) {
+		start = entry_work_stats_start();
 		ret = ptrace_report_syscall_entry(regs);
+		entry_work_stats_account(ENTRY_STAT_PTRACE, start);
 		if (ret || (work & SYSCALL_WORK_SYSCALL_EMU))
 			return -1L;
 	}
 
 	/* Do seccomp after ptrace, to catch any tracer changes. */
 	if (work & SYSCALL_WORK_SECCOMP) {
+		start = entry_work_stats_start();
 		ret = __secure_computing(NULL);
+		entry_work_stats_account(ENTRY_STAT_SECCOMP, start);
 		if (ret == -1L)
 			return ret;
 	}
@@ -90,8 +102,12 @@ __syscall_enter_from_user_work(struct pt_regs *regs, long syscall)
 {
 	unsigned long work = READ_ONCE(current_thread_info()->syscall_work);
 
-	if (work & SYSCALL_WORK_ENTER)
+	if (work & SYSCALL_WORK_ENTER) {
+		struct entry_work_stamp start = entry_work_stats_start();
+
 		syscall = syscall_trace_enter(regs, syscall, work);
+		entry_work_stats_account(ENTRY_STAT_SYSCALL_ENTER, start);
+	}
 
 	return syscall;
 }
@@ -147,6 +163,9 @@ void __weak arch_do_signal_or_restart(struct pt_regs *regs) { }
 static unsigned long exit_to_user_mode_loop(struct pt_regs *regs,
 					    unsigned long ti_work)
 {
+	struct entry_work_stamp loop_start = entry_work_stats_start();
+	struct entry_work_stamp start;
+
 	/*
 	 * Before returning to user space ensure that all pending work
 	 * items have been completed.
@@ -155,23 +174,42 @@ static unsigned long exit_to_user_mode_loop(struct pt_regs *regs,
 
 		local_irq_enable_exit_to_user(ti_work);
 
-		if (ti_work & _TIF_NEED_RESCHED_MASK)
+		if (ti_work & _TIF_NEED_RESCHED_MASK) {
+			start = entry_work_stats_start();
 			schedule();
+			entry_work_stats_account(ENTRY_STAT_RESCHED, start);
+		}
 
-		if (ti_work & _TIF_UPROBE)
+		if (ti_work & _TIF_UPROBE) {
+			start = entry_work_stats_start();
 			uprobe_notify_resume(regs);
+			entry_work_stats_account(ENTRY_STAT_UPROBE, start);
+		}
 
-		if (ti_work & _TIF_PATCH_PENDING)
+		if (ti_work & _TIF_PATCH_PENDING) {
+			start = entry_work_stats_start();
 			klp_update_patch_state(current);
+			entry_work_stats_account(ENTRY_STAT_PATCH, start);
+		}
 
-		if (ti_work & (_TIF_SIGPENDING | _TIF_NOTIFY_SIGNAL))
+		if (ti_work & (_TIF_SIGPENDING | _TIF_NOTIFY_SIGNAL)) {
+			start = entry_work_stats_start();
 			arch_do_signal_or_restart(regs);
+			entry_work_stats_account(ENTRY_STAT_SIGNAL, start);
+		}
 
-		if (ti_work & _TIF_NOTIFY_RESUME)
+		if (ti_work & _TIF_NOTIFY_RESUME) {
+			start = entry_work_stats_start();
 			resume_user_mode_work(regs);
+			entry_work_stats_account(ENTRY_STAT_NOTIFY_RESUME,
+						 start);
+		}
 
 		/* Architecture specific TIF work */
+		start = entry_work_stats_start();
 		arch_exit_to_user_mode_work(regs, ti_work);
+		if (ti_work & ARCH_EXIT_TO_USER_MODE_WORK)
+			entry_work_stats_account(ENTRY_STAT_ARCH, start);
 
 		/*
 		 * Disable interrupts and reevaluate the work flags as they
@@ -186,6 +224,8 @@ static unsigned long exit_to_user_mode_loop(struct pt_regs *regs,
 		ti_work = read_thread_flags();
 	}
 
+	entry_work_stats_account(ENTRY_STAT_EXIT_LOOP, loop_start);
+
 	/* Return the latest work state for arch_exit_to_user_mode() */
 	return ti_work;
 }
@@ -227,6 +267,7 @@ static inline bool report_single_step(unsigned long work)
 
 static void syscall_exit_work(struct pt_regs *regs, unsigned long work)
 {
+	struct entry_work_stamp start;
 	bool step;
 
 	/*
@@ -242,14 +283,20 @@ static void syscall_exit_work(struct pt_regs *regs, unsigned long work)
 		}
 	}
 
+	start = entry_work_stats_start();
 	audit_syscall_exit(regs);
+	if (work & SYSCALL_WORK_SYSCALL_AUDIT)
+		entry_work_stats_account(ENTRY_STAT_AUDIT, start);
 
 	if (work & SYSCALL_WORK_SYSCALL_TRACEPOINT)
 		trace_sys_exit(regs, syscall_get_return_value(current, regs));
 
 	step = report_single_step(work);
-	if (step || work & SYSCALL_WORK_SYSCALL_TRACE)
+	if (step || work & SYSCALL_WORK_SYSCALL_TRACE) {
+		start = entry_work_stats_start();
 		ptrace_report_syscall_exit(regs, step);
+		entry_work_stats_account(ENTRY_STAT_PTRACE, start);
+	}
 }
 
 /*
@@ -275,8 +322,12 @@ static void syscall_exit_to_user_mode_prepare(struct pt_regs *regs)
 	 * enabled, we want to run them exactly once per syscall exit with
 	 * interrupts enabled.
 	 */
-	if (unlikely(work & SYSCALL_WORK_EXIT))
+	if (unlikely(work & SYSCALL_WORK_EXIT)) {
+		struct entry_work_stamp start = entry_work_stats_start();
+
 		syscall_exit_work(regs, work);
+		entry_work_stats_account(ENTRY_STAT_SYSCALL_EXIT, start);
+	}
 }
 
 static __always_inline void __syscall_exit_to_user_mode_work(struct pt_regs *regs)
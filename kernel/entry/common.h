@@ -2,6 +2,75 @@
 #ifndef _COMMON_H
 #define _COMMON_H
 
+#include <linux/jump_label.h>
+#include <linux/sched.h>
+#include <linux/sched/clock.h>
+
 bool syscall_user_dispatch(struct pt_regs *regs);
 
+enum entry_work_stat {
+	ENTRY_STAT_SYSCALL_ENTER,
+	ENTRY_STAT_USER_DISPATCH,
+	ENTRY_STAT_PTRACE,
+	ENTRY_STAT_SECCOMP,
+	ENTRY_STAT_AUDIT,
+	ENTRY_STAT_SYSCALL_EXIT,
+	ENTRY_STAT_EXIT_LOOP,
+	ENTRY_STAT_RESCHED,
+	ENTRY_STAT_UPROBE,
+	ENTRY_STAT_PATCH,
+	ENTRY_STAT_SIGNAL,
+	ENTRY_STAT_NOTIFY_RESUME,
+	ENTRY_STAT_ARCH,
+	NR_ENTRY_STATS
+};
+
+/*
+ * Start of a timed work item. Work that schedules away may also migrate,
+ * so a sample is only timed if the task did not switch out in between.
+ */
+struct entry_work_stamp {
+	u64		clock;
+	unsigned long	switches;
+};
+
+#ifdef CONFIG_ENTRY_WORK_STATS
+DECLARE_STATIC_KEY_FALSE(entry_work_stats_key);
+
+void __entry_work_stats_account(enum entry_work_stat item,
+				struct entry_work_stamp start);
+
+static __always_inline unsigned long entry_work_switches(void)
+{
+	return current->nvcsw + current->nivcsw;
+}
+
+static __always_inline struct entry_work_stamp entry_work_stats_start(void)
+{
+	struct entry_work_stamp start = { };
+
+	if (static_branch_unlikely(&entry_work_stats_key)) {
+		start.switches = entry_work_switches();
+		start.clock = local_clock();
+	}
+	return start;
+}
+
+static __always_inline void
+entry_work_stats_account(enum entry_work_stat item, struct entry_work_stamp start)
+{
+	/* A zero clock means collection got enabled in between */
+	if (static_branch_unlikely(&entry_work_stats_key) && start.clock)
+		__entry_work_stats_account(item, start);
+}
+#else
+static __always_inline struct entry_work_stamp entry_work_stats_start(void)
+{
+	return (struct entry_work_stamp){ };
+}
+static __always_inline void
+entry_work_stats_account(enum entry_work_stat item,
+			 struct entry_work_stamp start) { }
+#endif
+
 #endif
@@ -0,0 +1,157 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Per-CPU statistics on syscall entry/exit work.
+ *
+ * When enabled through <tracefs>/entry_work_stats, every slow path work
+ * item handled in kernel/entry/common.c is timed with local_clock() and
+ * accounted into a per-CPU log2 histogram. Items during which the task
+ * was switched out, e.g. rescheduling or a ptrace stop, are only counted
+ * as switched: their duration is mostly time spent off the CPU, and may
+ * span CPUs. Writing 1 to the file clears the counters and enables
+ * collection, writing 0 disables it. While disabled the only cost on the
+ * entry/exit paths is a patched out static branch.
+ */
+
+#include <linux/cpumask.h>
+#include <linux/init.h>
+#include <linux/jump_label.h>
+#include <linux/kstrtox.h>
+#include <linux/mutex.h>
+#include <linux/percpu.h>
+#include <linux/sched/clock.h>
+#include <linux/seq_file.h>
+#include <linux/string.h>
+#include <linux/tracefs.h>
+
+#include "common.h"
+
+/* Bucket 0 is < 256ns, bucket i is [128ns << i, 256ns << i) */
+#define ENTRY_STATS_SHIFT	8
+#define ENTRY_STATS_BUCKETS	16
+
+struct entry_work_stats {
+	u64 count[NR_ENTRY_STATS];
+	u64 switched[NR_ENTRY_STATS];
+	u64 total_ns[NR_ENTRY_STATS];
+	u64 hist[NR_ENTRY_STATS][ENTRY_STATS_BUCKETS];
+};
+
+static const char * const entry_stat_names[NR_ENTRY_STATS] = {
+	[ENTRY_STAT_SYSCALL_ENTER]	= "syscall_enter",
+	[ENTRY_STAT_USER_DISPATCH]	= "user_dispatch",
+	[ENTRY_STAT_PTRACE]		= "ptrace",
+	[ENTRY_STAT_SECCOMP]		= "seccomp",
+	[ENTRY_STAT_AUDIT]		= "audit",
+	[ENTRY_STAT_SYSCALL_EXIT]	= "syscall_exit",
+	[ENTRY_STAT_EXIT_LOOP]		= "exit_loop",
+	[ENTRY_STAT_RESCHED]		= "resched",
+	[ENTRY_STAT_UPROBE]		= "uprobe",
+	[ENTRY_STAT_PATCH]		= "klp_patch",
+	[ENTRY_STAT_SIGNAL]		= "signal",
+	[ENTRY_STAT_NOTIFY_RESUME]	= "notify_resume",
+	[ENTRY_STAT_ARCH]		= "arch",
+};
+
+DEFINE_STATIC_KEY_FALSE(entry_work_stats_key);
+static DEFINE_PER_CPU(struct entry_work_stats, entry_work_stats);
+static DEFINE_MUTEX(entry_work_stats_mutex);
+
+void __entry_work_stats_account(enum entry_work_stat item,
+				struct entry_work_stamp start)
+{
+	u64 delta = local_clock() - start.clock;
+	int bucket;
+
+	if (entry_work_switches() != start.switches) {
+		this_cpu_inc(entry_work_stats.switched[item]);
+		return;
+	}
+
+	bucket = min(fls64(delta >> ENTRY_STATS_SHIFT),
+		     ENTRY_STATS_BUCKETS - 1);
+	this_cpu_inc(entry_work_stats.count[item]);
+	this_cpu_add(entry_work_stats.total_ns[item], delta);
+	this_cpu_inc(entry_work_stats.hist[item][bucket]);
+}
+
+static int entry_work_stats_show(struct seq_file *m, void *v)
+{
+	int cpu, i, b;
+
+	seq_printf(m, "# enabled: %d\n",
+		   static_key_enabled(&entry_work_stats_key));
+	seq_puts(m, "# cpu work count switched total_ns");
+	for (b = 0; b < ENTRY_STATS_BUCKETS - 1; b++)
+		seq_printf(m, " <%lluns", 1ULL << (ENTRY_STATS_SHIFT + b));
+	seq_printf(m, " >=%lluns\n",
+		   1ULL << (ENTRY_STATS_SHIFT + ENTRY_STATS_BUCKETS - 2));
+
+	for_each_possible_cpu(cpu) {
+		struct entry_work_stats *s = per_cpu_ptr(&entry_work_stats, cpu);
+
+		for (i = 0; i < NR_ENTRY_STATS; i++) {
+			u64 count = READ_ONCE(s->count[i]);
+			u64 switched = READ_ONCE(s->switched[i]);
+
+			if (!count && !switched)
+				continue;
+
+			seq_printf(m, "%d %s %llu %llu %llu", cpu,
+				   entry_stat_names[i], count, switched,
+				   READ_ONCE(s->total_ns[i]));
+			for (b = 0; b < ENTRY_STATS_BUCKETS; b++)
+				seq_printf(m, " %llu", READ_ONCE(s->hist[i][b]));
+			seq_putc(m, '\n');
+		}
+		cond_resched();
+	}
+
+	return 0;
+}
+
+static int entry_work_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, entry_work_stats_show, NULL);
+}
+
+static ssize_t entry_work_stats_write(struct file *file,
+				      const char __user *ubuf,
+				      size_t count, loff_t *ppos)
+{
+	bool enable;
+	int cpu, ret;
+
+	ret = kstrtobool_from_user(ubuf, count, &enable);
+	if (ret)
+		return ret;
+
+	mutex_lock(&entry_work_stats_mutex);
+	if (enable) {
+		/* Start from a clean slate, racing updates are harmless */
+		for_each_possible_cpu(cpu)
+			memset(per_cpu_ptr(&entry_work_stats, cpu), 0,
+			       sizeof(struct entry_work_stats));
+		static_branch_enable(&entry_work_stats_key);
+	} else {
+		static_branch_disable(&entry_work_stats_key);
+	}
+	mutex_unlock(&entry_work_stats_mutex);
+
+	return count;
+}
+
+static const struct file_operations entry_work_stats_fops = {
+	.open		= entry_work_stats_open,
+	.read		= seq_read,
+	.write		= entry_work_stats_write,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static __init int entry_work_stats_init(void)
+{
+	tracefs_create_file("entry_work_stats", 0640, NULL, NULL,
+			    &entry_work_stats_fops);
+	return 0;
+}
+late_initcall(entry_work_stats_init);
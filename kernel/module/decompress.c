@@ -141,7 +141,7 @@ out:
 	vfree(s.workspace);
 	return retval;
 }
-#elif CONFIG_MODULE_COMPRESS_XZ
+#elif defined(CONFIG_MODULE_COMPRESS_XZ)
 #include <linux/xz.h>
 #define MODULE_COMPRESSION	xz
 #define MODULE_DECOMPRESS_FN	module_xz_decompress
@@ -199,6 +199,119 @@ static ssize_t module_xz_decompress(struct load_info *info,
 	xz_dec_end(xz_dec);
 	return retval;
 }
+#elif defined(CONFIG_MODULE_COMPRESS_ZSTD)
+#include <linux/zstd.h>
+#define MODULE_COMPRESSION	zstd
+#define MODULE_DECOMPRESS_FN	module_zstd_decompress
+
+/*
+ * Don't trust a frame content size that claims a compression ratio
+ * higher than this, fall back to growing the page array instead.
+ */
+#define MODULE_ZSTD_MAX_RATIO	64
+
+static ssize_t module_zstd_decompress(struct load_info *info,
+				      const void *buf, size_t size)
+{
+	static const u8 signature[] = { 0x28, 0xb5, 0x2f, 0xfd };
+	zstd_out_buffer zstd_dec;
+	zstd_in_buffer zstd_buf;
+	zstd_frame_header header;
+	zstd_dstream *dstream;
+	size_t new_size = 0;
+	size_t wksp_size;
+	void *wksp = NULL;
+	ssize_t retval;
+	size_t ret;
+	int error;
+
+	if (size < sizeof(signature) ||
+	    memcmp(buf, signature, sizeof(signature))) {
+		pr_err("not a zstd compressed module\n");
+		return -EINVAL;
+	}
+
+	zstd_buf.src = buf;
+	zstd_buf.pos = 0;
+	zstd_buf.size = size;
+
+	ret = zstd_get_frame_header(&header, zstd_buf.src, zstd_buf.size);
+	if (ret != 0) {
+		pr_err("ZSTD-compressed data has an incomplete frame header\n");
+		return -EINVAL;
+	}
+
+	if (header.windowSize > (1 << ZSTD_WINDOWLOG_MAX)) {
+		pr_err("ZSTD-compressed data has too large a window size\n");
+		return -EINVAL;
+	}
+
+	/*
+	 * zstd records the uncompressed size in the frame header, so the
+	 * page array can be sized exactly up front instead of being grown
+	 * (and copied) while decompressing.
+	 */
+	if (header.frameContentSize != ZSTD_CONTENTSIZE_UNKNOWN &&
+	    header.frameContentSize <= (u64)size * MODULE_ZSTD_MAX_RATIO) {
+		unsigned int n_pages = DIV_ROUND_UP(header.frameContentSize,
+						    PAGE_SIZE);
+
+		if (n_pages > info->max_pages) {
+			error = module_extend_max_pages(info,
+							n_pages - info->max_pages);
+			if (error)
+				return error;
+		}
+	}
+
+	wksp_size = zstd_dstream_workspace_bound(header.windowSize);
+	wksp = vmalloc(wksp_size);
+	if (!wksp)
+		return -ENOMEM;
+
+	dstream = zstd_init_dstream(header.windowSize, wksp, wksp_size);
+	if (!dstream) {
+		pr_err("Can't initialize ZSTD stream\n");
+		retval = -ENOMEM;
+		goto out;
+	}
+
+	do {
+		struct page *page = module_get_next_page(info);
+
+		if (IS_ERR(page)) {
+			retval = PTR_ERR(page);
+			goto out;
+		}
+
+		zstd_dec.dst = kmap_local_page(page);
+		zstd_dec.pos = 0;
+		zstd_dec.size = PAGE_SIZE;
+
+		ret = zstd_decompress_stream(dstream, &zstd_dec, &zstd_buf);
+		kunmap_local(zstd_dec.dst);
+		if (zstd_is_error(ret)) {
+			pr_err("ZSTD-decompression failed with status %d\n",
+			       zstd_get_error_code(ret));
+			retval = -EINVAL;
+			goto out;
+		}
+
+		new_size += zstd_dec.pos;
+	} while (zstd_dec.pos == PAGE_SIZE && ret != 0);
+
+	if (ret != 0) {
+		pr_err("ZSTD-compressed data is truncated\n");
+		retval = -EINVAL;
+		goto out;
+	}
+
+	retval = new_size;
+
+ out:
+	vfree(wksp);
+	return retval;
+}
 #else
 #error "Unexpected configuration for CONFIG_MODULE_DECOMPRESS"
 #endif
@@ -215,6 +328,8 @@ int module_decompress(struct load_info *info, const void *buf, size_t size)
 	 */
 	n_pages = DIV_ROUND_UP(size, PAGE_SIZE) * 2;
 	error = module_extend_max_pages(info, n_pages);
+	if (error)
+		goto err;
 
 	data_size = MODULE_DECOMPRESS_FN(info, buf, size);
 	if (data_size < 0) {
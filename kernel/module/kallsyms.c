@@ -9,6 +9,7 @@
 #include <linux/kallsyms.h>
 #include <linux/buildid.h>
 #include <linux/bsearch.h>
+#include <linux/sort.h>
 #include "internal.h"
 
 /* Lookup exported symbol in given range of kernel_symbols */
@@ -140,6 +141,10 @@ void layout_symtab(struct module *mod, struct load_info *info)
 	/* Note add_kallsyms() computes strtab_size as core_typeoffs - stroffs */
 	info->core_typeoffs = mod->data_layout.size;
 	mod->data_layout.size += ndst * sizeof(char);
+	/* Room for the address-sorted index of the core symbols. */
+	info->core_addroffs = ALIGN(mod->data_layout.size,
+				    __alignof__(unsigned int));
+	mod->data_layout.size = info->core_addroffs + ndst * sizeof(unsigned int);
 	mod->data_layout.size = strict_align(mod->data_layout.size);
 
 	/* Put string table section at end of init part of module. */
@@ -155,9 +160,86 @@ void layout_symtab(struct module *mod, struct load_info *info)
 	mod->init_layout.size += sizeof(struct mod_kallsyms);
 	info->init_typeoffs = mod->init_layout.size;
 	mod->init_layout.size += nsrc * sizeof(char);
+	info->init_addroffs = ALIGN(mod->init_layout.size,
+				    __alignof__(unsigned int));
+	mod->init_layout.size = info->init_addroffs + nsrc * sizeof(unsigned int);
 	mod->init_layout.size = strict_align(mod->init_layout.size);
 }
 
+/*
+ * This ignores the intensely annoying "mapping symbols" found
+ * in ARM ELF files: $a, $t and $d.
+ */
+static inline int is_arm_mapping_symbol(const char *str)
+{
+	if (str[0] == '.' && str[1] == 'L')
+		return true;
+	return str[0] == '$' && strchr("axtd", str[1]) &&
+	       (str[2] == '\0' || str[2] == '.');
+}
+
+static const char *kallsyms_symbol_name(struct mod_kallsyms *kallsyms, unsigned int symnum)
+{
+	return kallsyms->strtab + kallsyms->symtab[symnum].st_name;
+}
+
+/*
+ * Symbols that find_kallsyms_symbol() may return: defined, named, and
+ * not one of the ARM mapping symbols.  ELF starts real symbols at 1.
+ */
+static bool is_addr_lookup_symbol(struct mod_kallsyms *kallsyms,
+				  unsigned int symnum)
+{
+	const char *name = kallsyms_symbol_name(kallsyms, symnum);
+
+	return symnum != 0 &&
+	       kallsyms->symtab[symnum].st_shndx != SHN_UNDEF &&
+	       *name != '\0' && !is_arm_mapping_symbol(name);
+}
+
+static int cmp_addrtab(const void *a, const void *b, const void *priv)
+{
+	const struct mod_kallsyms *kallsyms = priv;
+	unsigned int ia = *(const unsigned int *)a;
+	unsigned int ib = *(const unsigned int *)b;
+	unsigned long va = kallsyms_symbol_value(&kallsyms->symtab[ia]);
+	unsigned long vb = kallsyms_symbol_value(&kallsyms->symtab[ib]);
+
+	/* Break ties on the symbol index so aliases resolve as before. */
+	if (va != vb)
+		return va < vb ? -1 : 1;
+	return ia < ib ? -1 : ia > ib;
+}
+
+/*
+ * Build the index used by find_kallsyms_symbol() to binary search for
+ * the symbol containing an address.  Livepatch modules get their
+ * SHN_LIVEPATCH symbol values resolved after load, which would break
+ * the ordering, so they keep using the linear scan.
+ */
+static void build_kallsyms_addrtab(struct module *mod,
+				   struct mod_kallsyms *kallsyms,
+				   unsigned int *addrtab)
+{
+	unsigned int i, n = 0;
+
+	kallsyms->addrtab = NULL;
+	kallsyms->num_addrtab = 0;
+
+	if (is_livepatch_module(mod))
+		return;
+
+	for (i = 1; i < kallsyms->num_symtab; i++) {
+		if (is_addr_lookup_symbol(kallsyms, i))
+			addrtab[n++] = i;
+	}
+
+	sort_r(addrtab, n, sizeof(*addrtab), cmp_addrtab, NULL, kallsyms);
+
+	kallsyms->addrtab = addrtab;
+	kallsyms->num_addrtab = n;
+}
+
 /*
  * We use the full symtab and strtab which layout_symtab arranged to
  * be appended to the init section.  Later we switch to the cut-down
@@ -184,6 +266,8 @@ void add_kallsyms(struct module *mod, const struct load_info *info)
 	rcu_dereference(mod->kallsyms)->strtab =
 		(void *)info->sechdrs[info->index.str].sh_addr;
 	rcu_dereference(mod->kallsyms)->typetab = mod->init_layout.base + info->init_typeoffs;
+	build_kallsyms_addrtab(mod, rcu_dereference(mod->kallsyms),
+			       mod->init_layout.base + info->init_addroffs);
 
 	/*
 	 * Now populate the cut down core kallsyms for after init
@@ -216,6 +300,8 @@ void add_kallsyms(struct module *mod, const struct load_info *info)
 	}
 	rcu_read_unlock();
 	mod->core_kallsyms.num_symtab = ndst;
+	build_kallsyms_addrtab(mod, &mod->core_kallsyms,
+			       mod->data_layout.base + info->core_addroffs);
 }
 
 #if IS_ENABLED(CONFIG_STACKTRACE_BUILD_ID)
@@ -238,21 +324,56 @@ void init_build_id(struct module *mod, const struct load_info *info)
 }
 #endif
 
-/*
- * This ignores the intensely annoying "mapping symbols" found
- * in ARM ELF files: $a, $t and $d.
- */
-static inline int is_arm_mapping_symbol(const char *str)
+/* Value of the @pos'th symbol in address order. */
+static unsigned long addrtab_value(struct mod_kallsyms *kallsyms,
+				   unsigned int pos)
 {
-	if (str[0] == '.' && str[1] == 'L')
-		return true;
-	return str[0] == '$' && strchr("axtd", str[1]) &&
-	       (str[2] == '\0' || str[2] == '.');
+	return kallsyms_symbol_value(&kallsyms->symtab[kallsyms->addrtab[pos]]);
 }
 
-static const char *kallsyms_symbol_name(struct mod_kallsyms *kallsyms, unsigned int symnum)
+/* Number of entries in the address index whose value is <= @addr. */
+static unsigned int addrtab_upper_bound(struct mod_kallsyms *kallsyms,
+					unsigned long addr)
 {
-	return kallsyms->strtab + kallsyms->symtab[symnum].st_name;
+	unsigned int lo = 0, hi = kallsyms->num_addrtab;
+
+	while (lo < hi) {
+		unsigned int mid = lo + (hi - lo) / 2;
+
+		if (addrtab_value(kallsyms, mid) <= addr)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	return lo;
+}
+
+/*
+ * Binary search version of the scan in find_kallsyms_symbol(), returning
+ * the same symbol: the lowest-indexed one with the highest value <= @addr.
+ */
+static unsigned int find_kallsyms_symbol_sorted(struct mod_kallsyms *kallsyms,
+						unsigned long addr,
+						unsigned long *nextval)
+{
+	unsigned long bestval;
+	unsigned int pos;
+
+	pos = addrtab_upper_bound(kallsyms, addr);
+	if (pos < kallsyms->num_addrtab)
+		*nextval = min(*nextval, addrtab_value(kallsyms, pos));
+	if (!pos)
+		return 0;
+
+	bestval = addrtab_value(kallsyms, pos - 1);
+	if (bestval <= kallsyms_symbol_value(&kallsyms->symtab[0]))
+		return 0;
+
+	/* Walk back to the first alias at that address. */
+	pos = addrtab_upper_bound(kallsyms, bestval - 1);
+
+	return kallsyms->addrtab[pos];
 }
 
 /*
@@ -274,6 +395,11 @@ static const char *find_kallsyms_symbol(struct module *mod,
 	else
 		nextval = (unsigned long)mod->core_layout.base + mod->core_layout.text_size;
 
+	if (kallsyms->addrtab) {
+		best = find_kallsyms_symbol_sorted(kallsyms, addr, &nextval);
+		goto found;
+	}
+
 	bestval = kallsyms_symbol_value(&kallsyms->symtab[best]);
 
 	/*
@@ -284,15 +410,11 @@ static const char *find_kallsyms_symbol(struct module *mod,
 		const Elf_Sym *sym = &kallsyms->symtab[i];
 		unsigned long thisval = kallsyms_symbol_value(sym);
 
-		if (sym->st_shndx == SHN_UNDEF)
-			continue;
-
 		/*
 		 * We ignore unnamed symbols: they're uninformative
 		 * and inserted at a whim.
 		 */
-		if (*kallsyms_symbol_name(kallsyms, i) == '\0' ||
-		    is_arm_mapping_symbol(kallsyms_symbol_name(kallsyms, i)))
+		if (!is_addr_lookup_symbol(kallsyms, i))
 			continue;
 
 		if (thisval <= addr && thisval > bestval) {
@@ -303,9 +425,11 @@ static const char *find_kallsyms_symbol(struct module *mod,
 			nextval = thisval;
 	}
 
+found:
 	if (!best)
 		return NULL;
 
+	bestval = kallsyms_symbol_value(&kallsyms->symtab[best]);
 	if (size)
 		*size = nextval - bestval;
 	if (offset)
@@ -364,20 +488,17 @@ int lookup_module_symbol_name(unsigned long addr, char *symname)
 	struct module *mod;
 
 	preempt_disable();
-	list_for_each_entry_rcu(mod, &modules, list) {
-		if (mod->state == MODULE_STATE_UNFORMED)
-			continue;
-		if (within_module(addr, mod)) {
-			const char *sym;
+	mod = __module_address(addr);
+	if (mod) {
+		const char *sym;
 
-			sym = find_kallsyms_symbol(mod, addr, NULL, NULL);
-			if (!sym)
-				goto out;
+		sym = find_kallsyms_symbol(mod, addr, NULL, NULL);
+		if (!sym)
+			goto out;
 
-			strscpy(symname, sym, KSYM_NAME_LEN);
-			preempt_enable();
-			return 0;
-		}
+		strscpy(symname, sym, KSYM_NAME_LEN);
+		preempt_enable();
+		return 0;
 	}
 out:
 	preempt_enable();
@@ -390,22 +511,19 @@ int lookup_module_symbol_attrs(unsigned long addr, unsigned long *size,
 	struct module *mod;
 
 	preempt_disable();
-	list_for_each_entry_rcu(mod, &modules, list) {
-		if (mod->state == MODULE_STATE_UNFORMED)
-			continue;
-		if (within_module(addr, mod)) {
-			const char *sym;
+	mod = __module_address(addr);
+	if (mod) {
+		const char *sym;
 
-			sym = find_kallsyms_symbol(mod, addr, size, offset);
-			if (!sym)
-				goto out;
-			if (modname)
-				strscpy(modname, mod->name, MODULE_NAME_LEN);
-			if (name)
-				strscpy(name, sym, KSYM_NAME_LEN);
-			preempt_enable();
-			return 0;
-		}
+		sym = find_kallsyms_symbol(mod, addr, size, offset);
+		if (!sym)
+			goto out;
+		if (modname)
+			strscpy(modname, mod->name, MODULE_NAME_LEN);
+		if (name)
+			strscpy(name, sym, KSYM_NAME_LEN);
+		preempt_enable();
+		return 0;
 	}
 out:
 	preempt_enable();
@@ -0,0 +1,174 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Measure how many skbs per second the allocator and its per-CPU caches
+ * can hand out and take back:
+ *
+ *  - local:  napi_alloc_skb() and napi_consume_skb() on one CPU, as a
+ *            driver freeing what its own RX path allocated.
+ *  - small:  alloc_skb() and consume_skb() of small linear skbs, which
+ *            take their head from skbuff_small_head.
+ *  - remote: skbs allocated by napi_alloc_skb() on alloc_cpu and freed by
+ *            napi_consume_skb() on free_cpu, as TX completion on another
+ *            core does. Run it with net.core.skb_defer_tx_free set and
+ *            cleared to compare freeing locally with returning the skbs
+ *            to their allocating CPU.
+ *
+ * Results are printed to the kernel log. Loading always fails so that the
+ * benchmark can be run again without rmmod.
+ */
+
+#define pr_fmt(fmt) KBUILD_MODNAME ": " fmt
+
+#include <linux/init.h>
+#include <linux/module.h>
+#include <linux/moduleparam.h>
+#include <linux/printk.h>
+#include <linux/skbuff.h>
+#include <linux/netdevice.h>
+#include <linux/ktime.h>
+#include <linux/math64.h>
+#include <linux/workqueue.h>
+#include <linux/cpu.h>
+
+#define SMALL_LEN	128
+#define BATCH		256
+
+static unsigned int nr_skbs = 1000000;
+module_param(nr_skbs, uint, 0444);
+MODULE_PARM_DESC(nr_skbs, "Number of skbs allocated per run");
+
+static unsigned int len = 256;
+module_param(len, uint, 0444);
+MODULE_PARM_DESC(len, "Data length of local and remote run skbs");
+
+static unsigned int alloc_cpu;
+module_param(alloc_cpu, uint, 0444);
+MODULE_PARM_DESC(alloc_cpu, "CPU allocating skbs in the remote run");
+
+static unsigned int free_cpu = 1;
+module_param(free_cpu, uint, 0444);
+MODULE_PARM_DESC(free_cpu, "CPU freeing skbs in the remote run");
+
+/* __napi_alloc_skb() only looks at napi->dev */
+static struct napi_struct test_napi;
+
+static struct sk_buff *batch[BATCH];
+static unsigned int batch_len;
+
+static void report(const char *name, u64 nsec, unsigned int nr)
+{
+	pr_info("%-6s %u skbs in %llu us, %llu skbs/s\n", name, nr,
+		div_u64(nsec, NSEC_PER_USEC),
+		nsec ? div64_u64((u64)nr * NSEC_PER_SEC, nsec) : 0);
+}
+
+static void test_local(void)
+{
+	unsigned int i, done = 0;
+	u64 start, nsec = 0;
+
+	while (done < nr_skbs) {
+		local_bh_disable();
+		start = ktime_get_ns();
+		for (i = 0; i < BATCH && done < nr_skbs; i++, done++) {
+			struct sk_buff *skb = napi_alloc_skb(&test_napi, len);
+
+			if (!skb)
+				break;
+			napi_consume_skb(skb, 1);
+		}
+		nsec += ktime_get_ns() - start;
+		local_bh_enable();
+		if (i < BATCH && done < nr_skbs)
+			break;
+		cond_resched();
+	}
+	report("local", nsec, done);
+}
+
+static void test_small(void)
+{
+	unsigned int i, done = 0;
+	u64 start, nsec = 0;
+
+	while (done < nr_skbs) {
+		start = ktime_get_ns();
+		for (i = 0; i < BATCH && done < nr_skbs; i++, done++) {
+			struct sk_buff *skb = alloc_skb(SMALL_LEN, GFP_KERNEL);
+
+			if (!skb)
+				break;
+			consume_skb(skb);
+		}
+		nsec += ktime_get_ns() - start;
+		if (i < BATCH && done < nr_skbs)
+			break;
+		cond_resched();
+	}
+	report("small", nsec, done);
+}
+
+static long remote_alloc(void *arg)
+{
+	u64 start = ktime_get_ns();
+
+	local_bh_disable();
+	for (batch_len = 0; batch_len < BATCH; batch_len++) {
+		batch[batch_len] = napi_alloc_skb(&test_napi, len);
+		if (!batch[batch_len])
+			break;
+	}
+	local_bh_enable();
+
+	return ktime_get_ns() - start;
+}
+
+static long remote_free(void *arg)
+{
+	u64 start = ktime_get_ns();
+	unsigned int i;
+
+	local_bh_disable();
+	for (i = 0; i < batch_len; i++)
+		napi_consume_skb(batch[i], 1);
+	local_bh_enable();
+
+	return ktime_get_ns() - start;
+}
+
+static void test_remote(void)
+{
+	unsigned int done = 0;
+	u64 nsec = 0;
+
+	while (done < nr_skbs) {
+		nsec += work_on_cpu(alloc_cpu, remote_alloc, NULL);
+		nsec += work_on_cpu(free_cpu, remote_free, NULL);
+		done += batch_len;
+		if (batch_len < BATCH)
+			break;
+	}
+	report("remote", nsec, done);
+}
+
+static int __init test_skb_alloc_init(void)
+{
+	cpus_read_lock();
+	if (alloc_cpu >= nr_cpu_ids || !cpu_online(alloc_cpu) ||
+	    free_cpu >= nr_cpu_ids || !cpu_online(free_cpu)) {
+		cpus_read_unlock();
+		pr_err("alloc_cpu and free_cpu must be online\n");
+		return -EINVAL;
+	}
+
+	test_local();
+	test_small();
+	test_remote();
+	cpus_read_unlock();
+
+	return -EAGAIN;
+}
+module_init(test_skb_alloc_init);
+
+MODULE_DESCRIPTION("skb allocation benchmark");
+MODULE_LICENSE("GPL");
@@ -239,6 +239,7 @@ static char *pkt_flag_names[] = {
 #define PKTGEN_MAGIC 0xbe9be955
 #define PG_PROC_DIR "pktgen"
 #define PGCTRL	    "pgctrl"
+#define PGRX	    "pgrx"
 
 #define MAX_CFLOWS  65536
 
@@ -449,6 +450,7 @@ struct pktgen_net {
 	struct proc_dir_entry	*proc_dir;
 	struct list_head	pktgen_threads;
 	bool			pktgen_exiting;
+	struct pktgen_rx	*rx;		/* receive sink, under RTNL */
 };
 
 struct pktgen_thread {
@@ -2045,6 +2047,349 @@ static void pktgen_change_name(const struct pktgen_net *pn, struct net_device *d
 	mutex_unlock(&pktgen_thread_lock);
 }
 
+/*
+ * Receive side sink, /proc/net/pktgen/pgrx
+ *
+ * "rx <ifname>" attaches an rx_handler to a device that consumes pktgen
+ * UDP packets and accounts one-way latency from the transmit timestamp
+ * (sender and sink must share a clock, e.g. two namespaces on one host,
+ * and the sender must run with clone_skb 0 for fresh timestamps), plus
+ * loss and reordering from the sequence numbers. pktgen numbers packets
+ * per device, so sequence tracking is per sender address. A late packet
+ * is only taken back from the lost count if its sequence number was
+ * skipped within the last PGRX_SEQ_WINDOW, anything else counts as a
+ * duplicate.
+ * "rx_reset" clears the counters and "rx_disable" detaches the sink.
+ */
+#define PGRX_LAT_BUCKETS	24	/* log2 of usecs */
+#define PGRX_SENDERS		16
+#define PGRX_SEQ_WINDOW		64
+
+struct pktgen_rx_sender {
+	struct in6_addr		saddr;
+	u32			next_seq;
+	u64			missing;	/* bit n: next_seq - 1 - n skipped */
+	u64			packets;
+	u64			lost;
+	u64			reordered;
+	u64			duplicates;
+};
+
+struct pktgen_rx {
+	struct net_device	*dev;
+	netdevice_tracker	dev_tracker;
+	spinlock_t		lock;
+	u64			packets;
+	u64			bytes;
+	u64			no_timestamp;
+	u64			lat_min;	/* nsecs */
+	u64			lat_max;
+	u64			lat_sum;
+	u64			lat_hist[PGRX_LAT_BUCKETS];
+	u64			untracked;	/* no free sender slot */
+	unsigned int		nr_senders;
+	struct pktgen_rx_sender	senders[PGRX_SENDERS];
+};
+
+static void pktgen_rx_clear(struct pktgen_rx *rx)
+{
+	spin_lock_bh(&rx->lock);
+	rx->packets = rx->bytes = rx->no_timestamp = 0;
+	rx->lat_min = U64_MAX;
+	rx->lat_max = rx->lat_sum = 0;
+	memset(rx->lat_hist, 0, sizeof(rx->lat_hist));
+	rx->untracked = 0;
+	rx->nr_senders = 0;
+	spin_unlock_bh(&rx->lock);
+}
+
+static struct pktgen_rx_sender *pktgen_rx_sender(struct pktgen_rx *rx,
+						 const struct in6_addr *saddr,
+						 u32 seq)
+{
+	struct pktgen_rx_sender *snd;
+	unsigned int i;
+
+	for (i = 0; i < rx->nr_senders; i++) {
+		if (ipv6_addr_equal(&rx->senders[i].saddr, saddr))
+			return &rx->senders[i];
+	}
+	if (rx->nr_senders == PGRX_SENDERS)
+		return NULL;
+
+	snd = &rx->senders[rx->nr_senders++];
+	memset(snd, 0, sizeof(*snd));
+	snd->saddr = *saddr;
+	snd->next_seq = seq;
+	return snd;
+}
+
+static void pktgen_rx_account(struct pktgen_rx *rx, struct sk_buff *skb,
+			      const struct pktgen_hdr *pgh,
+			      const struct in6_addr *saddr)
+{
+	u32 seq = ntohl(pgh->seq_num);
+	struct pktgen_rx_sender *snd;
+	s64 lat = -1;
+
+	if (pgh->tv_sec || pgh->tv_usec) {
+		ktime_t sent = ktime_set(ntohl(pgh->tv_sec),
+					 ntohl(pgh->tv_usec) * NSEC_PER_USEC);
+
+		/* clocks of different hosts may be skewed, clamp at zero */
+		lat = max_t(s64, ktime_to_ns(ktime_sub(ktime_get_real(), sent)), 0);
+	}
+
+	spin_lock(&rx->lock);
+	rx->packets++;
+	rx->bytes += skb->len;
+	if (lat < 0) {
+		rx->no_timestamp++;
+	} else {
+		u64 usecs = div_u64(lat, NSEC_PER_USEC);
+		unsigned int bucket = usecs ? ilog2(usecs) + 1 : 0;
+
+		rx->lat_min = min_t(u64, rx->lat_min, lat);
+		rx->lat_max = max_t(u64, rx->lat_max, lat);
+		rx->lat_sum += lat;
+		rx->lat_hist[min(bucket, PGRX_LAT_BUCKETS - 1)]++;
+	}
+
+	snd = pktgen_rx_sender(rx, saddr, seq);
+	if (!snd) {
+		rx->untracked++;
+	} else {
+		s32 delta = seq - snd->next_seq;
+
+		snd->packets++;
+		if (delta >= 0) {
+			snd->lost += delta;
+			snd->next_seq = seq + 1;
+			if (delta < PGRX_SEQ_WINDOW - 1)
+				snd->missing <<= delta + 1;
+			else
+				snd->missing = 0;
+			/* the skipped ones are now bits 1..delta */
+			if (delta)
+				snd->missing |= GENMASK_ULL(min(delta, PGRX_SEQ_WINDOW - 1), 1);
+		} else {
+			u32 late = snd->next_seq - 1 - seq;
+
+			if (late < PGRX_SEQ_WINDOW &&
+			    snd->missing & BIT_ULL(late)) {
+				/* counted as lost when it was skipped */
+				snd->missing &= ~BIT_ULL(late);
+				snd->reordered++;
+				snd->lost--;
+			} else {
+				snd->duplicates++;
+			}
+		}
+	}
+	spin_unlock(&rx->lock);
+}
+
+/* Return the offset of the pktgen header in @skb, or a negative value */
+static int pktgen_rx_parse(struct sk_buff *skb, struct in6_addr *saddr)
+{
+	switch (skb->protocol) {
+	case htons(ETH_P_IP): {
+		struct iphdr _iph;
+		const struct iphdr *iph;
+
+		iph = skb_header_pointer(skb, 0, sizeof(_iph), &_iph);
+		if (!iph || iph->version != 4 || iph->protocol != IPPROTO_UDP)
+			return -1;
+		ipv6_addr_set_v4mapped(iph->saddr, saddr);
+		return iph->ihl * 4 + sizeof(struct udphdr);
+	}
+	case htons(ETH_P_IPV6): {
+		struct ipv6hdr _ip6h;
+		const struct ipv6hdr *ip6h;
+
+		ip6h = skb_header_pointer(skb, 0, sizeof(_ip6h), &_ip6h);
+		if (!ip6h || ip6h->nexthdr != IPPROTO_UDP)
+			return -1;
+		*saddr = ip6h->saddr;
+		return sizeof(*ip6h) + sizeof(struct udphdr);
+	}
+	}
+	return -1;
+}
+
+static rx_handler_result_t pktgen_rx_handler(struct sk_buff **pskb)
+{
+	struct sk_buff *skb = *pskb;
+	struct pktgen_rx *rx = rcu_dereference(skb->dev->rx_handler_data);
+	struct pktgen_hdr _pgh;
+	const struct pktgen_hdr *pgh;
+	struct in6_addr saddr;
+	int offset;
+
+	offset = pktgen_rx_parse(skb, &saddr);
+	if (offset < 0)
+		return RX_HANDLER_PASS;
+
+	pgh = skb_header_pointer(skb, offset, sizeof(_pgh), &_pgh);
+	if (!pgh || pgh->pgh_magic != htonl(PKTGEN_MAGIC))
+		return RX_HANDLER_PASS;
+
+	pktgen_rx_account(rx, skb, pgh, &saddr);
+	consume_skb(skb);
+	return RX_HANDLER_CONSUMED;
+}
+
+static void __pktgen_rx_detach(struct pktgen_net *pn)
+{
+	struct pktgen_rx *rx = pn->rx;
+
+	ASSERT_RTNL();
+	if (!rx)
+		return;
+
+	netdev_rx_handler_unregister(rx->dev);
+	netdev_put(rx->dev, &rx->dev_tracker);
+	pn->rx = NULL;
+	kfree(rx);
+}
+
+static int pktgen_rx_attach(struct pktgen_net *pn, const char *ifname)
+{
+	struct net_device *dev;
+	struct pktgen_rx *rx;
+	int err;
+
+	rx = kzalloc(sizeof(*rx), GFP_KERNEL);
+	if (!rx)
+		return -ENOMEM;
+	spin_lock_init(&rx->lock);
+	pktgen_rx_clear(rx);
+
+	rtnl_lock();
+	__pktgen_rx_detach(pn);
+
+	dev = __dev_get_by_name(pn->net, ifname);
+	if (!dev) {
+		err = -ENODEV;
+		goto err_unlock;
+	}
+
+	err = netdev_rx_handler_register(dev, pktgen_rx_handler, rx);
+	if (err)
+		goto err_unlock;
+
+	rx->dev = dev;
+	netdev_hold(dev, &rx->dev_tracker, GFP_KERNEL);
+	pn->rx = rx;
+	rtnl_unlock();
+	return 0;
+
+err_unlock:
+	rtnl_unlock();
+	kfree(rx);
+	return err;
+}
+
+static int pgrx_show(struct seq_file *seq, void *v)
+{
+	struct pktgen_net *pn = seq->private;
+	struct pktgen_rx *rx;
+	unsigned int i;
+
+	rtnl_lock();
+	rx = pn->rx;
+	if (!rx) {
+		seq_puts(seq, "rx: disabled\n");
+		goto out;
+	}
+
+	spin_lock_bh(&rx->lock);
+	seq_printf(seq, "rx: %s\n", rx->dev->name);
+	seq_printf(seq, "packets: %llu  bytes: %llu  no_timestamp: %llu\n",
+		   rx->packets, rx->bytes, rx->no_timestamp);
+	if (rx->packets > rx->no_timestamp)
+		seq_printf(seq, "latency_ns: min %llu  avg %llu  max %llu\n",
+			   rx->lat_min,
+			   div64_u64(rx->lat_sum, rx->packets - rx->no_timestamp),
+			   rx->lat_max);
+	for (i = 0; i < PGRX_LAT_BUCKETS; i++) {
+		if (!rx->lat_hist[i])
+			continue;
+		if (i < PGRX_LAT_BUCKETS - 1)
+			seq_printf(seq, "  < %lluus: %llu\n",
+				   1ULL << i, rx->lat_hist[i]);
+		else
+			seq_printf(seq, "  >= %lluus: %llu\n",
+				   1ULL << (i - 1), rx->lat_hist[i]);
+	}
+	for (i = 0; i < rx->nr_senders; i++) {
+		struct pktgen_rx_sender *snd = &rx->senders[i];
+
+		seq_printf(seq, "sender %pI6c: packets %llu  lost %llu  reordered %llu  duplicates %llu\n",
+			   &snd->saddr, snd->packets, snd->lost, snd->reordered,
+			   snd->duplicates);
+	}
+	if (rx->untracked)
+		seq_printf(seq, "untracked: %llu\n", rx->untracked);
+	spin_unlock_bh(&rx->lock);
+out:
+	rtnl_unlock();
+	return 0;
+}
+
+static ssize_t pgrx_write(struct file *file, const char __user *buf,
+			  size_t count, loff_t *ppos)
+{
+	struct seq_file *seq = file->private_data;
+	struct pktgen_net *pn = seq->private;
+	char data[IFNAMSIZ + 8];
+	int err = 0;
+
+	if (!capable(CAP_NET_ADMIN))
+		return -EPERM;
+
+	if (count == 0)
+		return -EINVAL;
+
+	if (count > sizeof(data))
+		count = sizeof(data);
+
+	if (copy_from_user(data, buf, count))
+		return -EFAULT;
+
+	data[count - 1] = 0;	/* Strip trailing '\n' and terminate string */
+
+	if (!strncmp(data, "rx ", 3)) {
+		err = pktgen_rx_attach(pn, strim(data + 3));
+	} else if (!strcmp(data, "rx_reset")) {
+		rtnl_lock();
+		if (pn->rx)
+			pktgen_rx_clear(pn->rx);
+		rtnl_unlock();
+	} else if (!strcmp(data, "rx_disable")) {
+		rtnl_lock();
+		__pktgen_rx_detach(pn);
+		rtnl_unlock();
+	} else {
+		err = -EINVAL;
+	}
+
+	return err ? err : count;
+}
+
+static int pgrx_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, pgrx_show, pde_data(inode));
+}
+
+static const struct proc_ops pktgen_rx_proc_ops = {
+	.proc_open	= pgrx_open,
+	.proc_read	= seq_read,
+	.proc_lseek	= seq_lseek,
+	.proc_write	= pgrx_write,
+	.proc_release	= single_release,
+};
+
 static int pktgen_device_event(struct notifier_block *unused,
 			       unsigned long event, void *ptr)
 {
@@ -2065,6 +2410,8 @@ static int pktgen_device_event(struct notifier_block *unused,
 
 	case NETDEV_UNREGISTER:
 		pktgen_mark_device(pn, dev->name);
+		if (pn->rx && pn->rx->dev == dev)
+			__pktgen_rx_detach(pn);
 		break;
 	}
 
@@ -3943,6 +4290,13 @@ static int __net_init pg_net_init(struct net *net)
 		goto remove;
 	}
 
+	pe = proc_create_data(PGRX, 0600, pn->proc_dir, &pktgen_rx_proc_ops, pn);
+	if (pe == NULL) {
+		pr_err("cannot create %s procfs entry\n", PGRX);
+		ret = -EINVAL;
+		goto remove_entry;
+	}
+
 	for_each_online_cpu(cpu) {
 		int err;
 
@@ -3955,11 +4309,13 @@ static int __net_init pg_net_init(struct net *net)
 	if (list_empty(&pn->pktgen_threads)) {
 		pr_err("Initialization failed for all threads\n");
 		ret = -ENODEV;
-		goto remove_entry;
+		goto remove_rx_entry;
 	}
 
 	return 0;
 
+remove_rx_entry:
+	remove_proc_entry(PGRX, pn->proc_dir);
 remove_entry:
 	remove_proc_entry(PGCTRL, pn->proc_dir);
 remove:
@@ -3989,6 +4345,11 @@ static void __net_exit pg_net_exit(struct net *net)
 		kfree(t);
 	}
 
+	rtnl_lock();
+	__pktgen_rx_detach(pn);
+	rtnl_unlock();
+
+	remove_proc_entry(PGRX, pn->proc_dir);
 	remove_proc_entry(PGCTRL, pn->proc_dir);
 	remove_proc_entry(PG_PROC_DIR, pn->net->proc_net);
 }
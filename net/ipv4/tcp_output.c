@@ -44,6 +44,8 @@
 #include <linux/gfp.h>
 #include <linux/module.h>
 #include <linux/static_key.h>
+#include <linux/smpboot.h>
+#include <linux/cpuhotplug.h>
 
 #include <trace/events/tcp.h>
 
@@ -999,12 +1001,30 @@ static unsigned int tcp_established_options(struct sock *sk, struct sk_buff *skb
  * Since transmit from skb destructor is forbidden, we use a tasklet
  * to process all sockets that eventually need to send more skbs.
  * We use one tasklet per cpu, with its own queue of sockets.
+ *
+ * On PREEMPT_RT, or when booted with "tcp_tsq_threads[=<fifo priority>]",
+ * the queue is processed by a per cpu thread instead, and the pacing timer
+ * expires in hard irq context and queues the socket there too. This keeps
+ * TSQ and pacing out of ksoftirqd and lets them run at their own priority.
  */
 struct tsq_tasklet {
 	struct tasklet_struct	tasklet;
 	struct list_head	head; /* queue of tcp sockets */
 };
 static DEFINE_PER_CPU(struct tsq_tasklet, tsq_tasklet);
+static DEFINE_PER_CPU(struct task_struct *, tsq_thread);
+static DEFINE_NET_THREADS_PARAM(tsq_threads_param);
+
+static bool tcp_tsq_threads(void)
+{
+	return net_threads_enabled(&tsq_threads_param);
+}
+
+static int __init setup_tsq_threads(char *arg)
+{
+	return net_threads_param_setup(&tsq_threads_param, arg);
+}
+early_param("tcp_tsq_threads", setup_tsq_threads);
 
 static void tcp_tsq_write(struct sock *sk)
 {
@@ -1034,14 +1054,13 @@ static void tcp_tsq_handler(struct sock *sk)
 	bh_unlock_sock(sk);
 }
 /*
- * One tasklet per cpu tries to send more skbs.
- * We run in tasklet context but need to disable irqs when
+ * One tasklet (or thread) per cpu tries to send more skbs.
+ * We run with BH disabled but need to disable irqs when
  * transferring tsq->head because tcp_wfree() might
  * interrupt us (non NAPI drivers)
  */
-static void tcp_tasklet_func(struct tasklet_struct *t)
+static void tcp_tsq_process(struct tsq_tasklet *tsq)
 {
-	struct tsq_tasklet *tsq = from_tasklet(tsq,  t, tasklet);
 	LIST_HEAD(list);
 	unsigned long flags;
 	struct list_head *q, *n;
@@ -1065,6 +1084,66 @@ static void tcp_tasklet_func(struct tasklet_struct *t)
 	}
 }
 
+static void tcp_tasklet_func(struct tasklet_struct *t)
+{
+	tcp_tsq_process(from_tasklet(tsq, t, tasklet));
+}
+
+/* Queue a socket holding a sk_wmem_alloc reference, with irqs disabled */
+static void tcp_tsq_queue(struct sock *sk)
+{
+	struct tsq_tasklet *tsq = this_cpu_ptr(&tsq_tasklet);
+	bool empty = list_empty(&tsq->head);
+
+	list_add(&tcp_sk(sk)->tsq_node, &tsq->head);
+	if (!empty)
+		return;
+	if (tcp_tsq_threads())
+		wake_up_process(__this_cpu_read(tsq_thread));
+	else
+		tasklet_schedule(&tsq->tasklet);
+}
+
+static int tcp_tsq_thread_should_run(unsigned int cpu)
+{
+	return !list_empty(&per_cpu(tsq_tasklet, cpu).head);
+}
+
+static void tcp_tsq_thread_fn(unsigned int cpu)
+{
+	local_bh_disable();
+	tcp_tsq_process(per_cpu_ptr(&tsq_tasklet, cpu));
+	local_bh_enable();
+}
+
+static void tcp_tsq_thread_setup(unsigned int cpu)
+{
+	net_threads_set_prio(&tsq_threads_param);
+}
+
+static struct smp_hotplug_thread tsq_threads = {
+	.store			= &tsq_thread,
+	.thread_should_run	= tcp_tsq_thread_should_run,
+	.thread_fn		= tcp_tsq_thread_fn,
+	.thread_comm		= "tcp_tsq/%u",
+	.setup			= tcp_tsq_thread_setup,
+};
+
+/* Hand the sockets left on a dead cpu to this one, as tasklets do. */
+static int tcp_tsq_cpu_dead(unsigned int cpu)
+{
+	struct tsq_tasklet *tsq;
+
+	local_irq_disable();
+	tsq = this_cpu_ptr(&tsq_tasklet);
+	if (!list_empty(&per_cpu(tsq_tasklet, cpu).head)) {
+		list_splice_init(&per_cpu(tsq_tasklet, cpu).head, &tsq->head);
+		wake_up_process(__this_cpu_read(tsq_thread));
+	}
+	local_irq_enable();
+	return 0;
+}
+
 #define TCP_DEFERRED_ALL (TCPF_TSQ_DEFERRED |		\
 			  TCPF_WRITE_TIMER_DEFERRED |	\
 			  TCPF_DELACK_TIMER_DEFERRED |	\
@@ -1128,6 +1207,19 @@ void __init tcp_tasklet_init(void)
 		INIT_LIST_HEAD(&tsq->head);
 		tasklet_setup(&tsq->tasklet, tcp_tasklet_func);
 	}
+
+	if (tcp_tsq_threads()) {
+		BUG_ON(smpboot_register_percpu_thread(&tsq_threads));
+		WARN_ON(cpuhp_setup_state_nocalls(CPUHP_BP_PREPARE_DYN,
+						  "net/tcp_tsq:dead", NULL,
+						  tcp_tsq_cpu_dead) < 0);
+	}
+}
+
+enum hrtimer_mode tcp_pacing_timer_mode(void)
+{
+	return tcp_tsq_threads() ? HRTIMER_MODE_ABS_PINNED_HARD :
+				   HRTIMER_MODE_ABS_PINNED_SOFT;
 }
 
 /*
@@ -1138,11 +1230,10 @@ void __init tcp_tasklet_init(void)
 void tcp_wfree(struct sk_buff *skb)
 {
 	struct sock *sk = skb->sk;
-	struct tcp_sock *tp = tcp_sk(sk);
 	unsigned long flags, nval, oval;
 
 	/* Keep one reference on sk_wmem_alloc.
-	 * Will be released by sk_free() from here or tcp_tasklet_func()
+	 * Will be released by sk_free() from here or tcp_tsq_process()
 	 */
 	WARN_ON(refcount_sub_and_test(skb->truesize - 1, &sk->sk_wmem_alloc));
 
@@ -1157,9 +1248,6 @@ void tcp_wfree(struct sk_buff *skb)
 		goto out;
 
 	for (oval = READ_ONCE(sk->sk_tsq_flags);; oval = nval) {
-		struct tsq_tasklet *tsq;
-		bool empty;
-
 		if (!(oval & TSQF_THROTTLED) || (oval & TSQF_QUEUED))
 			goto out;
 
@@ -1170,11 +1258,7 @@ void tcp_wfree(struct sk_buff *skb)
 
 		/* queue this socket to tasklet queue */
 		local_irq_save(flags);
-		tsq = this_cpu_ptr(&tsq_tasklet);
-		empty = list_empty(&tsq->head);
-		list_add(&tp->tsq_node, &tsq->head);
-		if (empty)
-			tasklet_schedule(&tsq->tasklet);
+		tcp_tsq_queue(sk);
 		local_irq_restore(flags);
 		return;
 	}
@@ -1182,7 +1266,27 @@ out:
 	sk_free(sk);
 }
 
-/* Note: Called under soft irq.
+/* With TSQ threads the pacing timer expires in hard irq, where the socket
+ * can neither be locked nor freed. Trade the timer's socket reference for a
+ * sk_wmem_alloc one and queue the socket for the TSQ thread. If it already
+ * is queued, the queue holds its own sk_wmem_alloc reference until after
+ * TSQ_QUEUED is cleared, so ours can be dropped unless it became the last.
+ */
+static enum hrtimer_restart tcp_pace_kick_hard(struct sock *sk)
+{
+	refcount_inc(&sk->sk_wmem_alloc);
+	sock_put(sk);
+
+	while (test_and_set_bit(TSQ_QUEUED, &sk->sk_tsq_flags)) {
+		if (refcount_dec_not_one(&sk->sk_wmem_alloc))
+			return HRTIMER_NORESTART;
+	}
+	tcp_tsq_queue(sk);
+
+	return HRTIMER_NORESTART;
+}
+
+/* Note: Called under soft irq, or hard irq when TSQ uses threads.
  * We can call TCP stack right away, unless socket is owned by user.
  */
 enum hrtimer_restart tcp_pace_kick(struct hrtimer *timer)
@@ -1190,6 +1294,9 @@ enum hrtimer_restart tcp_pace_kick(struct hrtimer *timer)
 	struct tcp_sock *tp = container_of(timer, struct tcp_sock, pacing_timer);
 	struct sock *sk = (struct sock *)tp;
 
+	if (tcp_tsq_threads())
+		return tcp_pace_kick_hard(sk);
+
 	tcp_tsq_handler(sk);
 	sock_put(sk);
 
@@ -2483,7 +2590,7 @@ static bool tcp_pacing_check(struct sock *sk)
 	if (!hrtimer_is_queued(&tp->pacing_timer)) {
 		hrtimer_start(&tp->pacing_timer,
 			      ns_to_ktime(tp->tcp_wstamp_ns),
-			      HRTIMER_MODE_ABS_PINNED_SOFT);
+			      tcp_pacing_timer_mode());
 		sock_hold(sk);
 	}
 	return true;
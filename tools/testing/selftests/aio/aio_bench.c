@@ -0,0 +1,199 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Linux AIO submission and completion benchmark
+ *
+ * Submits batches of O_DIRECT reads (or writes) to a device or file with
+ * io_submit() and reaps them with io_getevents(), and prints the achieved
+ * IOPS. Meant for brd, where requests complete during submission, so the
+ * cost measured is mostly that of the aio submission and completion
+ * paths. Uses the raw syscalls, libaio is not needed.
+ *
+ * Usage: aio_bench [-b <block size>] [-d <iocbs per io_submit>] [-e]
+ *		    [-n] [-t <seconds>] [-w] <device or file>
+ *   -e  signal an eventfd for each completion and read it
+ *   -n  submit with RWF_NOWAIT
+ *   -w  write instead of read
+ */
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <linux/aio_abi.h>
+#include <linux/fs.h>
+#include <sys/eventfd.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+
+#define MAX_DEPTH	256
+
+static int io_setup(unsigned int nr, aio_context_t *ctx)
+{
+	return syscall(__NR_io_setup, nr, ctx);
+}
+
+static int io_destroy(aio_context_t ctx)
+{
+	return syscall(__NR_io_destroy, ctx);
+}
+
+static int io_submit(aio_context_t ctx, long nr, struct iocb **iocbs)
+{
+	return syscall(__NR_io_submit, ctx, nr, iocbs);
+}
+
+static int io_getevents(aio_context_t ctx, long min_nr, long nr,
+			struct io_event *events, struct timespec *timeout)
+{
+	return syscall(__NR_io_getevents, ctx, min_nr, nr, events, timeout);
+}
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void die(const char *what)
+{
+	perror(what);
+	exit(EXIT_FAILURE);
+}
+
+static void usage(const char *prog)
+{
+	fprintf(stderr,
+		"usage: %s [-b <bs>] [-d <depth>] [-e] [-n] [-t <secs>] [-w] <path>\n",
+		prog);
+	exit(EXIT_FAILURE);
+}
+
+int main(int argc, char *argv[])
+{
+	unsigned int bs = 4096, depth = 32, secs = 5, i;
+	int efd = -1, fd, opt, rw_flags = 0, do_write = 0;
+	struct iocb iocbs[MAX_DEPTH], *iocbps[MAX_DEPTH];
+	struct io_event events[MAX_DEPTH];
+	unsigned long long ops = 0, submits = 0, blocks;
+	aio_context_t ctx = 0;
+	double start, end;
+	struct stat st;
+	uint64_t size;
+	char *buf;
+
+	while ((opt = getopt(argc, argv, "b:d:ent:w")) != -1) {
+		switch (opt) {
+		case 'b':
+			bs = strtoul(optarg, NULL, 0);
+			break;
+		case 'd':
+			depth = strtoul(optarg, NULL, 0);
+			break;
+		case 'e':
+			efd = eventfd(0, 0);
+			if (efd < 0)
+				die("eventfd");
+			break;
+		case 'n':
+			rw_flags = RWF_NOWAIT;
+			break;
+		case 't':
+			secs = strtoul(optarg, NULL, 0);
+			break;
+		case 'w':
+			do_write = 1;
+			break;
+		default:
+			usage(argv[0]);
+		}
+	}
+	if (optind != argc - 1 || !bs || bs % 512 || !depth ||
+	    depth > MAX_DEPTH)
+		usage(argv[0]);
+
+	fd = open(argv[optind], (do_write ? O_RDWR : O_RDONLY) | O_DIRECT);
+	if (fd < 0 || fstat(fd, &st))
+		die(argv[optind]);
+	if (S_ISBLK(st.st_mode)) {
+		if (ioctl(fd, BLKGETSIZE64, &size))
+			die("BLKGETSIZE64");
+	} else {
+		size = st.st_size;
+	}
+	blocks = size / bs;
+	if (blocks < depth) {
+		fprintf(stderr, "%s: too small\n", argv[optind]);
+		return EXIT_FAILURE;
+	}
+
+	if (posix_memalign((void **)&buf, 4096, (size_t)bs * depth))
+		die("posix_memalign");
+	memset(buf, 0xa5, (size_t)bs * depth);
+	if (io_setup(depth, &ctx))
+		die("io_setup");
+
+	for (i = 0; i < depth; i++) {
+		memset(&iocbs[i], 0, sizeof(iocbs[i]));
+		iocbs[i].aio_fildes = fd;
+		iocbs[i].aio_lio_opcode = do_write ? IOCB_CMD_PWRITE :
+						  IOCB_CMD_PREAD;
+		iocbs[i].aio_buf = (uintptr_t)(buf + (size_t)bs * i);
+		iocbs[i].aio_nbytes = bs;
+		iocbs[i].aio_rw_flags = rw_flags;
+		if (efd >= 0) {
+			iocbs[i].aio_flags = IOCB_FLAG_RESFD;
+			iocbs[i].aio_resfd = efd;
+		}
+		iocbps[i] = &iocbs[i];
+	}
+
+	start = now();
+	end = start + secs;
+	do {
+		int n, j;
+
+		for (i = 0; i < depth; i++)
+			iocbs[i].aio_offset = (uint64_t)((ops + i) % blocks) * bs;
+
+		n = io_submit(ctx, depth, iocbps);
+		if (n != (int)depth)
+			die("io_submit");
+		submits++;
+
+		for (i = 0; i < depth; i += n) {
+			n = io_getevents(ctx, 1, depth - i, events, NULL);
+			if (n <= 0)
+				die("io_getevents");
+			for (j = 0; j < n; j++) {
+				if (events[j].res != bs) {
+					errno = events[j].res < 0 ?
+						-events[j].res : EIO;
+					die("aio");
+				}
+			}
+		}
+		if (efd >= 0) {
+			uint64_t cnt;
+
+			if (read(efd, &cnt, sizeof(cnt)) != sizeof(cnt))
+				die("eventfd read");
+		}
+		ops += depth;
+	} while (now() < end);
+	end = now();
+
+	printf("%s %u bytes, depth %u%s%s: %.0f IOPS, %.0f io_submit/s\n",
+	       do_write ? "write" : "read", bs, depth,
+	       rw_flags ? ", nowait" : "", efd >= 0 ? ", eventfd" : "",
+	       ops / (end - start), submits / (end - start));
+
+	io_destroy(ctx);
+	return EXIT_SUCCESS;
+}
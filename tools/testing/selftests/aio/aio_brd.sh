@@ -0,0 +1,45 @@
+#!/bin/bash
+# SPDX-License-Identifier: GPL-2.0
+#
+# Run aio_bench against a brd ram disk: reads and writes, with and without
+# RWF_NOWAIT and eventfd completions, at a few submission depths. brd
+# completes requests during io_submit(), so this measures the aio
+# submission and completion paths. Results are printed; the test fails
+# only if a run fails.
+
+ksft_skip=4
+DEV=/dev/ram0
+SECS=${SECS:-3}
+loaded=0
+ret=0
+
+cleanup()
+{
+	[ $loaded -eq 1 ] && modprobe -r brd
+}
+
+if [ "$(id -u)" -ne 0 ]; then
+	echo "SKIP: need root"
+	exit $ksft_skip
+fi
+
+if [ ! -b $DEV ]; then
+	if ! modprobe brd rd_nr=1 rd_size=65536; then
+		echo "SKIP: brd not available"
+		exit $ksft_skip
+	fi
+	loaded=1
+fi
+trap cleanup EXIT
+
+dd if=/dev/zero of=$DEV bs=1M count=64 oflag=direct status=none
+
+for rw in "" "-w"; do
+	for flags in "" "-n" "-e" "-n -e"; do
+		for depth in 1 16 64; do
+			./aio_bench -t "$SECS" -d $depth $rw $flags $DEV || ret=1
+		done
+	done
+done
+
+exit $ret
@@ -3493,4 +3493,83 @@ TEST(epoll64)
 	close(ctx.sfd[1]);
 }
 
+#define EPOLL65_PRODUCERS	8
+#define EPOLL65_EVENTS		20000
+
+struct epoll_mpcontext {
+	int efd[EPOLL65_PRODUCERS];
+};
+
+static void *producer_entry(void *data)
+{
+	int fd = *(int *)data;
+	int i;
+
+	for (i = 0; i < EPOLL65_EVENTS; i++)
+		if (eventfd_write(fd, 1))
+			break;
+
+	return NULL;
+}
+
+/*
+ *     p0 ... p7
+ *      |      |
+ *     e0 ... e7
+ *       \    / (et)
+ *         ep
+ *          | (ew)
+ *         t0
+ */
+TEST(epoll65)
+{
+	pthread_t producer[EPOLL65_PRODUCERS];
+	struct epoll_event events[EPOLL65_PRODUCERS];
+	struct epoll_mpcontext ctx;
+	unsigned long long total = 0;
+	eventfd_t v;
+	int i, n, ep;
+
+	ep = epoll_create1(0);
+	ASSERT_GE(ep, 0);
+
+	for (i = 0; i < EPOLL65_PRODUCERS; i++) {
+		struct epoll_event e = {
+			.events = EPOLLIN | EPOLLET,
+			.data.u32 = i,
+		};
+
+		ctx.efd[i] = eventfd(0, EFD_NONBLOCK);
+		ASSERT_GE(ctx.efd[i], 0);
+		ASSERT_EQ(epoll_ctl(ep, EPOLL_CTL_ADD, ctx.efd[i], &e), 0);
+	}
+
+	/*
+	 * Many producers queue events concurrently while main consumes
+	 * them. Every write must end up either in a value read back or in
+	 * a wakeup; a lost one leaves epoll_wait() timing out.
+	 */
+	for (i = 0; i < EPOLL65_PRODUCERS; i++)
+		ASSERT_EQ(pthread_create(&producer[i], NULL, producer_entry,
+					 &ctx.efd[i]), 0);
+
+	while (total < (unsigned long long)EPOLL65_PRODUCERS * EPOLL65_EVENTS) {
+		n = epoll_wait(ep, events, EPOLL65_PRODUCERS, 1000);
+		ASSERT_GT(n, 0);
+
+		for (i = 0; i < n; i++)
+			if (!eventfd_read(ctx.efd[events[i].data.u32], &v))
+				total += v;
+	}
+
+	for (i = 0; i < EPOLL65_PRODUCERS; i++)
+		ASSERT_EQ(pthread_join(producer[i], NULL), 0);
+
+	EXPECT_EQ(total, (unsigned long long)EPOLL65_PRODUCERS * EPOLL65_EVENTS);
+
+	for (i = 0; i < EPOLL65_PRODUCERS; i++)
+		close(ctx.efd[i]);
+	close(ep);
+}
+
 TEST_HARNESS_MAIN
@@ -0,0 +1,89 @@
+#!/bin/bash
+# SPDX-License-Identifier: GPL-2.0
+#
+# Receive a TCP stream and ping over a veth pair with RPS steering the
+# packets to another CPU, and report throughput and latency. The backlog
+# is processed by NET_RX_SOFTIRQ after an IPI, or by the backlog_napi/N
+# threads when booted with "thread_backlog_napi[=<prio>]" (always with
+# PREEMPT_RT). Run it once in each mode to compare them; the mode in use
+# is printed first. Each mode is also measured without RPS as a baseline.
+#
+# Requires iperf3 and at least two CPUs.
+
+ksft_skip=4
+ret=0
+
+NS_TX="rps-tx-$$"
+NS_RX="rps-rx-$$"
+DURATION=${DURATION:-10}
+RX_CPU=${RX_CPU:-0}
+RPS_CPU=${RPS_CPU:-1}
+
+cleanup()
+{
+	ip netns pids "$NS_RX" 2>/dev/null | xargs -r kill 2>/dev/null
+	ip netns del "$NS_TX" 2>/dev/null
+	ip netns del "$NS_RX" 2>/dev/null
+}
+
+skip()
+{
+	echo "SKIP: $1"
+	exit $ksft_skip
+}
+
+[ "$(id -u)" -eq 0 ] || skip "need root"
+command -v iperf3 >/dev/null || skip "iperf3 not installed"
+[ "$(nproc)" -ge 2 ] || skip "need at least two CPUs"
+
+trap cleanup EXIT
+
+ip netns add "$NS_TX" || skip "cannot create network namespaces"
+ip netns add "$NS_RX"
+ip link add veth0 netns "$NS_TX" type veth peer name veth1 netns "$NS_RX" ||
+	skip "veth not supported"
+ip -n "$NS_TX" addr add 10.0.0.1/24 dev veth0
+ip -n "$NS_RX" addr add 10.0.0.2/24 dev veth1
+ip -n "$NS_TX" link set veth0 up
+ip -n "$NS_RX" link set veth1 up
+
+rps_cpus=/sys/class/net/veth1/queues/rx-0/rps_cpus
+
+if pgrep -x "backlog_napi/$RPS_CPU" >/dev/null; then
+	echo "backlog processed by backlog_napi threads"
+else
+	echo "backlog processed by NET_RX_SOFTIRQ"
+fi
+
+# $1: rps_cpus mask, 0 to disable RPS
+run()
+{
+	local mask=$1
+	local bps rtt
+
+	ip netns exec "$NS_RX" sh -c "echo $mask > $rps_cpus" || return 1
+
+	ip netns exec "$NS_RX" taskset -c "$RX_CPU" iperf3 -s -1 -D
+	sleep 1
+	ip netns exec "$NS_TX" ping -q -i 0.01 -w "$DURATION" 10.0.0.2 \
+		> /tmp/rps_ping.$$ &
+	bps=$(ip netns exec "$NS_TX" iperf3 -c 10.0.0.2 -t "$DURATION" -J |
+	      sed -n 's/.*"bits_per_second":[[:space:]]*\([0-9.e+]*\).*/\1/p' |
+	      tail -1)
+	wait
+	rtt=$(sed -n 's|.*= [0-9.]*/\([0-9.]*\)/\([0-9.]*\)/.*|avg \1 ms max \2 ms|p' \
+	      /tmp/rps_ping.$$)
+	rm -f /tmp/rps_ping.$$
+
+	if [ -z "$bps" ] || [ -z "$rtt" ]; then
+		echo "FAIL: rps_cpus=$mask: no result"
+		return 1
+	fi
+	awk -v m="$mask" -v b="$bps" -v r="$rtt" \
+		'BEGIN { printf "rps_cpus=%-4s %6.0f Mbit/s, ping rtt %s\n", m, b / 1e6, r }'
+}
+
+run 0 || ret=1
+run "$(printf '%x' $((1 << RPS_CPU)))" || ret=1
+
+exit $ret
@@ -0,0 +1,85 @@
+#!/bin/bash
+# SPDX-License-Identifier: GPL-2.0
+#
+# Measure the latency of a small request/response flow while paced bulk
+# TCP flows run on the same CPUs over a veth pair. TSQ and pacing work
+# runs in the TSQ tasklet and ksoftirqd, or in the tcp_tsq/N threads when
+# booted with "tcp_tsq_threads[=<prio>]" (always with PREEMPT_RT). Run it
+# once in each mode to compare them; the mode in use is printed first.
+# Each mode is also measured without bulk traffic as a baseline.
+#
+# Requires iperf3.
+
+ksft_skip=4
+ret=0
+
+NS_TX="tsq-tx-$$"
+NS_RX="tsq-rx-$$"
+DURATION=${DURATION:-10}
+FLOWS=${FLOWS:-4}
+RATE=${RATE:-500M}
+
+cleanup()
+{
+	ip netns pids "$NS_TX" 2>/dev/null | xargs -r kill 2>/dev/null
+	ip netns pids "$NS_RX" 2>/dev/null | xargs -r kill 2>/dev/null
+	ip netns del "$NS_TX" 2>/dev/null
+	ip netns del "$NS_RX" 2>/dev/null
+}
+
+skip()
+{
+	echo "SKIP: $1"
+	exit $ksft_skip
+}
+
+[ "$(id -u)" -eq 0 ] || skip "need root"
+command -v iperf3 >/dev/null || skip "iperf3 not installed"
+
+trap cleanup EXIT
+
+ip netns add "$NS_TX" || skip "cannot create network namespaces"
+ip netns add "$NS_RX"
+ip link add veth0 netns "$NS_TX" type veth peer name veth1 netns "$NS_RX" ||
+	skip "veth not supported"
+ip -n "$NS_TX" addr add 10.0.0.1/24 dev veth0
+ip -n "$NS_RX" addr add 10.0.0.2/24 dev veth1
+ip -n "$NS_TX" link set veth0 up
+ip -n "$NS_RX" link set veth1 up
+tc -n "$NS_TX" qdisc replace dev veth0 root fq || skip "fq qdisc not supported"
+
+if pgrep -x "tcp_tsq/0" >/dev/null; then
+	echo "TSQ processed by tcp_tsq threads"
+else
+	echo "TSQ processed by tasklet"
+fi
+
+# $1: number of paced bulk flows, 0 for none
+run()
+{
+	local flows=$1
+	local rtt
+
+	if [ "$flows" -gt 0 ]; then
+		ip netns exec "$NS_RX" iperf3 -s -1 -D
+		sleep 1
+		ip netns exec "$NS_TX" iperf3 -c 10.0.0.2 -t "$DURATION" \
+			-P "$flows" --fq-rate "$RATE" > /dev/null &
+		sleep 1
+	fi
+
+	rtt=$(ip netns exec "$NS_TX" ping -q -i 0.01 -w "$DURATION" 10.0.0.2 |
+	      sed -n 's|.*= [0-9.]*/\([0-9.]*\)/\([0-9.]*\)/.*|avg \1 ms max \2 ms|p')
+	wait
+
+	if [ -z "$rtt" ]; then
+		echo "FAIL: $flows bulk flows: no result"
+		return 1
+	fi
+	printf "%d bulk flows at %s: ping rtt %s\n" "$flows" "$RATE" "$rtt"
+}
+
+run 0 || ret=1
+run "$FLOWS" || ret=1
+
+exit $ret
@@ -0,0 +1,187 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Check that pipes using multi-page buffers (fs.pipe-folio-order) are
+ * charged for them against fs.pipe-user-pages-soft, also across a resize.
+ *
+ * With the soft limit set to exactly one default pipe of order 3 buffers,
+ * an unprivileged user fills pipe A with large buffers and opens a second
+ * pipe to go over the limit. Resizing A to its current size then falls
+ * back to single pages for new buffers, but A must stay charged for the
+ * queued ones, so another new pipe still gets the minimum size. Once A is
+ * drained and resized again, its charge drops and a new pipe gets the
+ * default size again.
+ *
+ * Needs root to set the sysctls and switch to an unused uid. The large
+ * buffers are allocated opportunistically; on a heavily fragmented system
+ * the first check can fail spuriously.
+ */
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include "../kselftest.h"
+
+#define FOLIO_ORDER	3
+#define DEF_BUFFERS	16
+#define MIN_BUFFERS	2
+#define TEST_UID	54321
+
+static const char order_path[] = "/proc/sys/fs/pipe-folio-order";
+static const char soft_path[] = "/proc/sys/fs/pipe-user-pages-soft";
+static const char hard_path[] = "/proc/sys/fs/pipe-user-pages-hard";
+
+static char saved_order[32], saved_soft[32], saved_hard[32];
+
+static int read_sysctl(const char *path, char *buf, size_t len)
+{
+	int fd = open(path, O_RDONLY);
+	ssize_t n;
+
+	if (fd < 0)
+		return -1;
+	n = read(fd, buf, len - 1);
+	close(fd);
+	if (n <= 0)
+		return -1;
+	buf[n] = '\0';
+	return 0;
+}
+
+static int write_sysctl(const char *path, const char *val)
+{
+	int fd = open(path, O_WRONLY);
+	ssize_t n;
+
+	if (fd < 0)
+		return -1;
+	n = write(fd, val, strlen(val));
+	close(fd);
+	return n == (ssize_t)strlen(val) ? 0 : -1;
+}
+
+static void restore_sysctls(void)
+{
+	write_sysctl(order_path, saved_order);
+	write_sysctl(soft_path, saved_soft);
+	write_sysctl(hard_path, saved_hard);
+}
+
+static int pipe_slots(int fd, long page_size)
+{
+	int size = fcntl(fd, F_GETPIPE_SZ);
+
+	return size < 0 ? -1 : size / page_size;
+}
+
+/* Create a pipe and check how many slots the limits left it */
+static int check_new_pipe(long page_size, int expect, const char *what)
+{
+	int p[2], slots;
+
+	if (pipe(p))
+		ksft_exit_fail_msg("pipe: %s\n", strerror(errno));
+	slots = pipe_slots(p[1], page_size);
+	close(p[0]);
+	if (slots == expect) {
+		ksft_test_result_pass("%s\n", what);
+		return 0;
+	}
+	ksft_test_result_fail("%s: new pipe got %d slots, expected %d\n",
+			      what, slots, expect);
+	return 1;
+}
+
+/* Runs as TEST_UID, returns the number of failed checks */
+static int run_checks(long page_size)
+{
+	size_t len = (size_t)DEF_BUFFERS * (page_size << FOLIO_ORDER);
+	int a[2], b[2], fails = 0;
+	char *buf = malloc(len);
+	ssize_t n;
+
+	if (!buf || pipe2(a, O_NONBLOCK))
+		ksft_exit_fail_msg("setup: %s\n", strerror(errno));
+	memset(buf, 'x', len);
+
+	if (pipe_slots(a[1], page_size) != DEF_BUFFERS)
+		ksft_exit_fail_msg("pipe A does not have %d slots\n",
+				   DEF_BUFFERS);
+
+	/* A takes the whole allowance with large buffers */
+	n = write(a[1], buf, len);
+	if (n <= (ssize_t)(page_size * DEF_BUFFERS))
+		ksft_exit_fail_msg("pipe A took %zd bytes, large buffers not used\n",
+				   n);
+
+	/* B puts the user over the soft limit */
+	if (pipe(b))
+		ksft_exit_fail_msg("pipe B: %s\n", strerror(errno));
+	if (pipe_slots(b[1], page_size) != MIN_BUFFERS)
+		ksft_exit_fail_msg("pipe B not limited to %d slots\n",
+				   MIN_BUFFERS);
+
+	/* Over the limit, so A's resize drops the order of new buffers */
+	if (fcntl(a[1], F_SETPIPE_SZ, DEF_BUFFERS * page_size) < 0)
+		ksft_exit_fail_msg("resize A: %s\n", strerror(errno));
+	fails += check_new_pipe(page_size, MIN_BUFFERS,
+				"queued large buffers stay charged");
+
+	/* Drained and resized, A is charged for single pages only */
+	while (read(a[0], buf, len) > 0)
+		;
+	if (fcntl(a[1], F_SETPIPE_SZ, DEF_BUFFERS * page_size) < 0)
+		ksft_exit_fail_msg("resize A: %s\n", strerror(errno));
+	fails += check_new_pipe(page_size, DEF_BUFFERS,
+				"drained pipe drops its large charge");
+
+	free(buf);
+	return fails;
+}
+
+int main(void)
+{
+	long page_size = sysconf(_SC_PAGESIZE);
+	char soft[32];
+	int status;
+	pid_t pid;
+
+	ksft_print_header();
+
+	if (geteuid())
+		ksft_exit_skip("must be run as root\n");
+	if (read_sysctl(order_path, saved_order, sizeof(saved_order)))
+		ksft_exit_skip("%s not supported\n", order_path);
+	if (read_sysctl(soft_path, saved_soft, sizeof(saved_soft)) ||
+	    read_sysctl(hard_path, saved_hard, sizeof(saved_hard)))
+		ksft_exit_fail_msg("cannot read pipe limits\n");
+
+	snprintf(soft, sizeof(soft), "%d", DEF_BUFFERS << FOLIO_ORDER);
+	if (write_sysctl(order_path, "3") || write_sysctl(soft_path, soft) ||
+	    write_sysctl(hard_path, "0")) {
+		restore_sysctls();
+		ksft_exit_fail_msg("cannot set pipe sysctls\n");
+	}
+
+	pid = fork();
+	if (pid < 0) {
+		restore_sysctls();
+		ksft_exit_fail_msg("fork: %s\n", strerror(errno));
+	}
+	if (!pid) {
+		if (setgid(TEST_UID) || setuid(TEST_UID))
+			ksft_exit_fail_msg("setuid: %s\n", strerror(errno));
+		exit(run_checks(page_size) ? 1 : 0);
+	}
+
+	waitpid(pid, &status, 0);
+	restore_sysctls();
+
+	if (!WIFEXITED(status) || WEXITSTATUS(status))
+		ksft_exit_fail();
+	ksft_exit_pass();
+}
@@ -0,0 +1,123 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Pipe throughput benchmark
+ *
+ * Streams data from a writer to a reader process through a pipe for each
+ * combination of writer and reader chunk sizes, and prints the throughput.
+ * Run it with different fs.pipe-folio-order settings to compare single
+ * page buffers with multi-page ones; the current setting is printed first.
+ *
+ * Usage: pipe_bench [-m <MiB per run>] [-p <pipe size>]
+ */
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+static const size_t chunks[] = {
+	4096, 16384, 65536, 262144, 1048576,
+};
+#define NR_CHUNKS	(sizeof(chunks) / sizeof(chunks[0]))
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void die(const char *what)
+{
+	perror(what);
+	exit(EXIT_FAILURE);
+}
+
+/* Returns MiB/s for moving @total bytes */
+static double run(size_t total, size_t wchunk, size_t rchunk, int pipe_size)
+{
+	char *buf = malloc(wchunk > rchunk ? wchunk : rchunk);
+	size_t left = total;
+	double start;
+	int p[2], status;
+	pid_t pid;
+	ssize_t n;
+
+	if (!buf || pipe(p))
+		die("pipe");
+	if (pipe_size && fcntl(p[1], F_SETPIPE_SZ, pipe_size) < 0)
+		die("F_SETPIPE_SZ");
+	memset(buf, 0x5a, wchunk > rchunk ? wchunk : rchunk);
+
+	fflush(stdout);
+	start = now();
+	pid = fork();
+	if (pid < 0)
+		die("fork");
+	if (!pid) {
+		close(p[1]);
+		while ((n = read(p[0], buf, rchunk)) > 0)
+			;
+		_exit(n < 0 ? EXIT_FAILURE : EXIT_SUCCESS);
+	}
+
+	close(p[0]);
+	while (left) {
+		n = write(p[1], buf, left < wchunk ? left : wchunk);
+		if (n < 0)
+			die("write");
+		left -= n;
+	}
+	close(p[1]);
+	if (waitpid(pid, &status, 0) < 0 || !WIFEXITED(status) ||
+	    WEXITSTATUS(status))
+		die("reader");
+
+	free(buf);
+	return total / (now() - start) / (1 << 20);
+}
+
+int main(int argc, char *argv[])
+{
+	size_t total = 256UL << 20;
+	int pipe_size = 0, opt;
+	unsigned int w, r;
+	char order[16] = "n/a\n";
+	FILE *f;
+
+	while ((opt = getopt(argc, argv, "m:p:")) != -1) {
+		switch (opt) {
+		case 'm':
+			total = strtoul(optarg, NULL, 0) << 20;
+			break;
+		case 'p':
+			pipe_size = strtol(optarg, NULL, 0);
+			break;
+		default:
+			fprintf(stderr, "usage: %s [-m <MiB>] [-p <pipe size>]\n",
+				argv[0]);
+			return EXIT_FAILURE;
+		}
+	}
+
+	f = fopen("/proc/sys/fs/pipe-folio-order", "r");
+	if (f) {
+		if (!fgets(order, sizeof(order), f))
+			strcpy(order, "?\n");
+		fclose(f);
+	}
+	printf("pipe-folio-order: %s", order);
+	printf("%10s %10s %10s\n", "write", "read", "MiB/s");
+
+	for (w = 0; w < NR_CHUNKS; w++)
+		for (r = 0; r < NR_CHUNKS; r++)
+			printf("%10zu %10zu %10.0f\n", chunks[w], chunks[r],
+			       run(total, chunks[w], chunks[r], pipe_size));
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,194 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Check that SPLICE_F_MOVE into a file keeps the data intact, whether or
+ * not the pipe pages end up moved into the page cache:
+ *
+ *  - pipe -> file: pages written into a pipe and moved into a file must
+ *    not change when the pipe is filled again afterwards.
+ *  - file -> pipe -> file: page cache pages of the source file must not
+ *    be taken from it, so the source stays intact and resident.
+ *
+ * Files are created in the directory given as argument, or the current
+ * one. Use a ramfs mount to exercise the page moving path.
+ */
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#define NR_PAGES	16
+
+static long page_size;
+static char path[PATH_MAX];
+
+static void fill(char *buf, size_t len, char seed)
+{
+	size_t i;
+
+	for (i = 0; i < len; i++)
+		buf[i] = seed + i % 251;
+}
+
+static int open_tmp(const char *dir, const char *name)
+{
+	int fd;
+
+	snprintf(path, sizeof(path), "%s/%s.%d", dir, name, getpid());
+	fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0600);
+	if (fd < 0) {
+		perror(path);
+		exit(EXIT_FAILURE);
+	}
+	unlink(path);
+	return fd;
+}
+
+static void splice_all(int in, int out, size_t len, unsigned int flags)
+{
+	ssize_t ret;
+
+	while (len) {
+		ret = splice(in, NULL, out, NULL, len, flags);
+		if (ret <= 0) {
+			perror("splice");
+			exit(EXIT_FAILURE);
+		}
+		len -= ret;
+	}
+}
+
+static int check(int fd, const char *expect, size_t len, const char *what)
+{
+	char *buf = malloc(len);
+
+	if (!buf || pread(fd, buf, len, 0) != (ssize_t)len) {
+		perror("pread");
+		exit(EXIT_FAILURE);
+	}
+	if (memcmp(buf, expect, len)) {
+		fprintf(stderr, "FAIL: %s: data mismatch\n", what);
+		free(buf);
+		return 1;
+	}
+	free(buf);
+	return 0;
+}
+
+/* Move pages out of a pipe, then overwrite whatever the pipe reuses */
+static int test_pipe_to_file(const char *dir, char *data, char *junk,
+			     size_t len)
+{
+	int p[2], fd, ret;
+
+	fd = open_tmp(dir, "splice_move_dst");
+	if (pipe(p) || fcntl(p[1], F_SETPIPE_SZ, len) < 0) {
+		perror("pipe");
+		exit(EXIT_FAILURE);
+	}
+
+	if (write(p[1], data, len) != (ssize_t)len) {
+		perror("write");
+		exit(EXIT_FAILURE);
+	}
+	splice_all(p[0], fd, len, SPLICE_F_MOVE);
+
+	if (write(p[1], junk, len) != (ssize_t)len ||
+	    read(p[0], junk, len) != (ssize_t)len) {
+		perror("pipe reuse");
+		exit(EXIT_FAILURE);
+	}
+
+	ret = check(fd, data, len, "pipe to file");
+	close(p[0]);
+	close(p[1]);
+	close(fd);
+	return ret;
+}
+
+static size_t resident(int fd, size_t len)
+{
+	unsigned char vec[NR_PAGES];
+	size_t i, n = 0;
+	void *map;
+
+	map = mmap(NULL, len, PROT_READ, MAP_SHARED, fd, 0);
+	if (map == MAP_FAILED || mincore(map, len, vec)) {
+		perror("mincore");
+		exit(EXIT_FAILURE);
+	}
+	for (i = 0; i < len / page_size; i++)
+		n += vec[i] & 1;
+	munmap(map, len);
+	return n;
+}
+
+/* Page cache pages of the source must stay where they are */
+static int test_file_to_file(const char *dir, char *data, size_t len)
+{
+	int p[2], src, dst, ret = 0;
+	size_t before, after;
+
+	src = open_tmp(dir, "splice_move_src");
+	dst = open_tmp(dir, "splice_move_dst");
+	if (pwrite(src, data, len, 0) != (ssize_t)len) {
+		perror("pwrite");
+		exit(EXIT_FAILURE);
+	}
+	fsync(src);
+	ret |= check(src, data, len, "source before splice");
+	before = resident(src, len);
+
+	if (pipe(p) || fcntl(p[1], F_SETPIPE_SZ, len) < 0) {
+		perror("pipe");
+		exit(EXIT_FAILURE);
+	}
+	splice_all(src, p[1], len, 0);
+	splice_all(p[0], dst, len, SPLICE_F_MOVE);
+
+	after = resident(src, len);
+	if (after < before) {
+		fprintf(stderr, "FAIL: %zu of %zu source pages evicted\n",
+			before - after, before);
+		ret = 1;
+	}
+	ret |= check(src, data, len, "source after splice");
+	ret |= check(dst, data, len, "file to file");
+
+	close(p[0]);
+	close(p[1]);
+	close(src);
+	close(dst);
+	return ret;
+}
+
+int main(int argc, char *argv[])
+{
+	const char *dir = argc > 1 ? argv[1] : ".";
+	char *data, *junk;
+	size_t len;
+	int ret = 0;
+
+	page_size = sysconf(_SC_PAGESIZE);
+	len = NR_PAGES * page_size;
+	data = aligned_alloc(page_size, len);
+	junk = aligned_alloc(page_size, len);
+	if (!data || !junk) {
+		perror("malloc");
+		return EXIT_FAILURE;
+	}
+	fill(data, len, 'a');
+	fill(junk, len, 'z');
+
+	ret |= test_pipe_to_file(dir, data, junk, len);
+	ret |= test_file_to_file(dir, data, len);
+
+	printf("%s\n", ret ? "FAIL" : "PASS");
+	return ret ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,170 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * TFD_TIMER_COARSE overhead test
+ *
+ * Arms many periodic timerfds with intervals that are not multiples of
+ * the timer slack, once precise and once with TFD_TIMER_COARSE, and
+ * waits for them with epoll. Coarse timers must still deliver all their
+ * expirations, while sharing slots and thus needing fewer wakeups per
+ * expiration than precise ones. Both runs are reported.
+ *
+ * The timerfds are blocking: after EPOLLIN a read must return a non-zero
+ * expiration count, also for coarse timers that ran before the hard end
+ * of their range.
+ */
+#define _GNU_SOURCE
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/prctl.h>
+#include <sys/resource.h>
+#include <sys/timerfd.h>
+#include "../kselftest.h"
+
+#ifndef TFD_TIMER_COARSE
+#define TFD_TIMER_COARSE	(1 << 2)
+#endif
+
+#define NR_TIMERS	500
+#define INTERVAL_NS	10000000LL	/* 10ms */
+#define STEP_NS		7000LL		/* per timer, off the slot grid */
+#define SLACK_NS	1000000UL	/* 1ms */
+#define RUN_SECS	2
+#define NSEC_PER_SEC	1000000000LL
+
+struct run {
+	unsigned long long wakeups;
+	unsigned long long expirations;
+	unsigned long long expected;
+	double cpu_ms;
+};
+
+static long long now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * NSEC_PER_SEC + ts.tv_nsec;
+}
+
+static double cpu_ms(void)
+{
+	struct rusage ru;
+
+	getrusage(RUSAGE_SELF, &ru);
+	return ru.ru_utime.tv_sec * 1e3 + ru.ru_utime.tv_usec / 1e3 +
+	       ru.ru_stime.tv_sec * 1e3 + ru.ru_stime.tv_usec / 1e3;
+}
+
+/* Returns -1 if the flags are not supported */
+static int run_timers(int flags, struct run *r)
+{
+	struct epoll_event ev, events[64];
+	int fds[NR_TIMERS], ep, i, n;
+	long long end;
+	double start_cpu;
+
+	memset(r, 0, sizeof(*r));
+	ep = epoll_create1(0);
+	if (ep < 0)
+		ksft_exit_fail_msg("epoll_create1: %s\n", strerror(errno));
+
+	for (i = 0; i < NR_TIMERS; i++) {
+		long long ival = INTERVAL_NS + i * STEP_NS;
+		struct itimerspec its = {
+			.it_value = { 0, ival },
+			.it_interval = { 0, ival },
+		};
+
+		fds[i] = timerfd_create(CLOCK_MONOTONIC, 0);
+		if (fds[i] < 0)
+			ksft_exit_fail_msg("timerfd_create: %s\n",
+					   strerror(errno));
+		if (timerfd_settime(fds[i], flags, &its, NULL)) {
+			if (errno == EINVAL && flags)
+				return -1;
+			ksft_exit_fail_msg("timerfd_settime: %s\n",
+					   strerror(errno));
+		}
+		ev.events = EPOLLIN;
+		ev.data.u32 = i;
+		if (epoll_ctl(ep, EPOLL_CTL_ADD, fds[i], &ev))
+			ksft_exit_fail_msg("epoll_ctl: %s\n", strerror(errno));
+		r->expected += RUN_SECS * NSEC_PER_SEC / ival;
+	}
+
+	start_cpu = cpu_ms();
+	end = now_ns() + RUN_SECS * NSEC_PER_SEC;
+	while (now_ns() < end) {
+		n = epoll_wait(ep, events, 64, 100);
+		if (n < 0 && errno != EINTR)
+			ksft_exit_fail_msg("epoll_wait: %s\n", strerror(errno));
+		if (n > 0)
+			r->wakeups++;
+		for (i = 0; i < n; i++) {
+			uint64_t ticks = 0;
+			ssize_t ret;
+
+			ret = read(fds[events[i].data.u32], &ticks,
+				   sizeof(ticks));
+			if (ret < 0 && errno == EINTR)
+				continue;
+			if (ret != sizeof(ticks) || !ticks)
+				ksft_exit_fail_msg("read after EPOLLIN returned %zd, %llu ticks: %s\n",
+						   ret, (unsigned long long)ticks,
+						   ret < 0 ? strerror(errno) : "short read");
+			r->expirations += ticks;
+		}
+	}
+	r->cpu_ms = cpu_ms() - start_cpu;
+
+	for (i = 0; i < NR_TIMERS; i++)
+		close(fds[i]);
+	close(ep);
+	return 0;
+}
+
+static void report(const char *name, struct run *r)
+{
+	printf("%-8s %llu/%llu expirations, %llu wakeups (%.3f per expiration), %.1f ms CPU\n",
+	       name, r->expirations, r->expected, r->wakeups,
+	       r->expirations ? (double)r->wakeups / r->expirations : 0,
+	       r->cpu_ms);
+}
+
+int main(void)
+{
+	struct run precise, coarse;
+	struct rlimit rl;
+
+	if (!getrlimit(RLIMIT_NOFILE, &rl) && rl.rlim_cur < NR_TIMERS + 16) {
+		rl.rlim_cur = NR_TIMERS + 16;
+		if (setrlimit(RLIMIT_NOFILE, &rl))
+			ksft_exit_skip("not enough file descriptors\n");
+	}
+	if (prctl(PR_SET_TIMERSLACK, SLACK_NS, 0, 0, 0))
+		ksft_exit_fail_msg("PR_SET_TIMERSLACK: %s\n", strerror(errno));
+
+	run_timers(0, &precise);
+	report("precise", &precise);
+
+	if (run_timers(TFD_TIMER_COARSE, &coarse))
+		ksft_exit_skip("TFD_TIMER_COARSE not supported\n");
+	report("coarse", &coarse);
+
+	/* Up to a slot late per period, and the last one may be pending */
+	if (coarse.expirations * 10 < coarse.expected * 9) {
+		printf("coarse timers lost expirations\n");
+		return ksft_exit_fail();
+	}
+	if (coarse.wakeups > precise.wakeups) {
+		printf("coarse timers needed more wakeups than precise ones\n");
+		return ksft_exit_fail();
+	}
+	return ksft_exit_pass();
+}